@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Process-wide heap allocation counter, used by Bench to check that the chunk pipelines make
+// no allocations per chunk once warm.
+//
+// Build with -DXEC_COUNT_ALLOCATIONS to replace the global operator new/delete with versions
+// that count every allocation; otherwise heap_allocations() always returns 0. The replacement
+// operators are ordinary (non-inline) definitions, so include this header from the one
+// translation unit that holds main().
+namespace xec {
+
+namespace alloc {
+
+inline std::atomic<uint64_t> &allocation_counter() {
+    static std::atomic<uint64_t> counter{0};
+    return counter;
+}
+
+inline void *counted_malloc(std::size_t size, std::size_t alignment) {
+    allocation_counter().fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) {
+        size = 1;
+    }
+    void *ptr = nullptr;
+    if (alignment <= alignof(std::max_align_t)) {
+        ptr = std::malloc(size);
+    } else if (posix_memalign(&ptr, alignment, size) != 0) {
+        ptr = nullptr;
+    }
+    return ptr;
+}
+
+// Out of line so the compiler does not pair free() with the operator new it inlined elsewhere
+// and warn about a mismatched deallocation
+__attribute__((noinline)) inline void counted_free(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+} // namespace alloc
+
+constexpr bool allocation_counting_enabled() {
+#ifdef XEC_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Function to return the number of heap allocations made so far by any thread
+inline uint64_t heap_allocations() {
+    return alloc::allocation_counter().load(std::memory_order_relaxed);
+}
+
+} // namespace xec
+
+#ifdef XEC_COUNT_ALLOCATIONS
+
+void *operator new(std::size_t size) {
+    if (void *ptr = xec::alloc::counted_malloc(size, alignof(std::max_align_t))) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return xec::alloc::counted_malloc(size, alignof(std::max_align_t));
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return xec::alloc::counted_malloc(size, alignof(std::max_align_t));
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    if (void *ptr = xec::alloc::counted_malloc(size, static_cast<std::size_t>(alignment))) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return ::operator new(size, alignment);
+}
+
+void operator delete(void *ptr) noexcept { xec::alloc::counted_free(ptr); }
+void operator delete[](void *ptr) noexcept { xec::alloc::counted_free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { xec::alloc::counted_free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { xec::alloc::counted_free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { xec::alloc::counted_free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { xec::alloc::counted_free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { xec::alloc::counted_free(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { xec::alloc::counted_free(ptr); }
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept { xec::alloc::counted_free(ptr); }
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept { xec::alloc::counted_free(ptr); }
+
+#endif // XEC_COUNT_ALLOCATIONS
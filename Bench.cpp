@@ -0,0 +1,712 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include "CipherContainer.h"
+#include "ChunkChecksum.h"
+#include "SegmentCipher.h"
+#include "WorkerPool.h"
+#include "ChunkRing.h"
+#include "ChunkEngine.h"
+#include "KeySchedule.h"
+#include "AllocCounter.h"
+#include "CipherStats.h"
+#include "CpuTopology.h"
+#include "TuneProfile.h"
+
+// Benchmark for the sequential (XecLDS_SDS / XEC_Dec_LDS) and parallel (ParaEn / ParaDec)
+// engines on deterministic synthetic inputs.
+//
+// Every measured run is split into separately timed stages so the numbers are comparable:
+//   encrypt: read (plaintext chunks), cipher, write (container)
+//   decrypt: read (container chunks), cipher, write (plaintext)
+// plus the end-to-end time of the overlapped streaming pipeline the binaries actually use; the
+// pipeline and mapped runs call the binaries' own engines (ChunkEngine.h).
+// Warmup runs are discarded; the rest are summarised as median/p95/p99 latency and
+// throughput (plaintext bytes per second) and optionally written as JSON.
+// --io compare (builds with -DXEC_HAVE_LIBURING -luring) also times the encrypt pipeline
+// with io_uring reads/writes as stage "pipeline_uring", next to the ifstream "pipeline".
+// Builds with -DXEC_COUNT_ALLOCATIONS also report the heap allocations per chunk the pipelines
+// make once every ring slot has finished a chunk (expected: 0).
+// --numa on pins the pool's workers to cores across the NUMA nodes, places each ring slot on
+// one node, and reports the pipeline throughput of each node's workers.
+// --tune FILE calibrates this host instead (see tune()) and writes the winning chunk size,
+// thread count and I/O backend to FILE as a TuneProfile for the four binaries to load.
+//
+// Usage: Bench [--sizes 1K,1M,64M] [--runs N] [--warmup N] [--threads N] [--chunk-size 1M]
+//              [--width 128|256] [--pattern random|text] [--seed N] [--dir bench]
+//              [--json results.json] [--label name] [--io stream|compare] [--numa on|off]
+//              [--tune xec.tune]
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+    std::vector<uint64_t> sizes = {1024, 1048576, 64 * 1048576ull};
+    std::size_t runs = 10;
+    std::size_t warmup = 2;
+    std::size_t threads = 0;
+    std::size_t chunk_size = 1048576;
+    std::size_t width = 256;
+    std::string pattern = "random";
+    uint64_t seed = 1;
+    std::string dir = "bench";
+    std::string json_path;
+    std::string label = "dev";
+    bool compare_io = false;
+    bool numa = false;
+    std::string tune_path;
+};
+
+// Per-run stage latencies in seconds
+struct StageTimes {
+    double read = 0.0;
+    double cipher = 0.0;
+    double write = 0.0;
+    double pipeline = 0.0;
+    double pipeline_uring = 0.0;
+};
+
+// Plaintext bytes transformed by each node's workers in the pipeline runs, and the runs' time
+struct NodeThroughput {
+    std::vector<uint64_t> bytes;
+    double seconds = 0.0;
+
+    void add(const xec::CipherStats &stats, double elapsed_s) {
+        std::vector<xec::CipherTotals> nodes = stats.node_totals();
+        bytes.resize(nodes.size(), 0);
+        for (std::size_t node = 0; node < nodes.size(); ++node) {
+            bytes[node] += nodes[node].bytes;
+        }
+        seconds += elapsed_s;
+    }
+
+    double rate(std::size_t node) const { return seconds > 0 ? bytes[node] / seconds : 0.0; }
+};
+
+struct Summary {
+    double median = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+};
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Function to parse sizes such as 512, 4K, 64M, 10G
+uint64_t parse_size(const std::string &text) {
+    std::size_t pos = 0;
+    uint64_t value = std::stoull(text, &pos);
+    if (pos < text.size()) {
+        switch (text[pos]) {
+            case 'K': case 'k': value <<= 10; break;
+            case 'M': case 'm': value <<= 20; break;
+            case 'G': case 'g': value <<= 30; break;
+            default: throw std::runtime_error("Bad size: " + text);
+        }
+    }
+    return value;
+}
+
+std::string format_size(uint64_t size) {
+    const char *units[] = {"B", "K", "M", "G"};
+    int unit = 0;
+    while (unit < 3 && size >= 1024 && size % 1024 == 0) {
+        size /= 1024;
+        ++unit;
+    }
+    return std::to_string(size) + units[unit];
+}
+
+// Function to compute nearest-rank percentiles of a sample set
+Summary summarize(std::vector<double> samples) {
+    Summary summary;
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto rank = [&](double p) {
+        std::size_t index = static_cast<std::size_t>(p * samples.size() + 0.999999);
+        return samples[std::min(samples.size(), std::max<std::size_t>(index, 1)) - 1];
+    };
+    summary.median = rank(0.50);
+    summary.p95 = rank(0.95);
+    summary.p99 = rank(0.99);
+    return summary;
+}
+
+// Function to write a deterministic synthetic dataset (xorshift64* stream) of `size` bytes.
+// "text" draws words from a small vocabulary so the data looks like the dataset/D*.txt inputs.
+void generate_dataset(const std::string &filename, uint64_t size, uint64_t seed, const std::string &pattern) {
+    static const char *words[] = {"the", "cipher", "segment", "chunk", "key", "mutation", "crossover",
+                                  "data", "avalanche", "effect", "parallel", "thread", "output", "input"};
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot open output file: " + filename);
+    }
+    uint64_t state = seed * 0x9E3779B97F4A7C15ull + 1;
+    auto next = [&state]() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    };
+    std::string block;
+    uint64_t written = 0;
+    while (written < size) {
+        block.clear();
+        while (block.size() < 1048576) {
+            uint64_t value = next();
+            if (pattern == "text") {
+                block += words[value % (sizeof(words) / sizeof(words[0]))];
+                block += (value >> 32) % 12 == 0 ? '\n' : ' ';
+            } else {
+                block.append(reinterpret_cast<const char *>(&value), sizeof(value));
+            }
+        }
+        std::size_t length = static_cast<std::size_t>(std::min<uint64_t>(block.size(), size - written));
+        out.write(block.data(), length);
+        written += length;
+    }
+}
+
+// Function to run the cipher over a batch of chunks, inline (sequential engine) or on the pool
+template <typename Fn>
+void for_each_chunk(std::vector<xec::ChunkSlot> &batch, std::size_t count, xec::WorkerPool *pool, Fn fn) {
+    for (std::size_t i = 0; i < count; ++i) {
+        if (pool) {
+            pool->submit([&batch, &fn, i]() { fn(batch[i]); });
+        } else {
+            fn(batch[i]);
+        }
+    }
+    if (pool) {
+        pool->wait_idle();
+    }
+}
+
+// Function to fail the run if any chunk of the container the benchmark just wrote did not verify
+inline void check_chunks(std::size_t failed_chunks, const std::string &filename) {
+    if (failed_chunks != 0) {
+        throw std::runtime_error("Benchmark container failed its checksums: " + filename);
+    }
+}
+
+// Function to encrypt `input` into a container with read, cipher and write timed separately.
+// Chunks move through the stages in batches of one chunk per worker so stages never overlap;
+// each chunk is encrypted by the engines' encrypt_chunk() with the binaries' KeySchedule.
+template <typename Cipher>
+StageTimes run_encrypt_stages(const std::string &input, const std::string &output, std::size_t chunk_size, xec::WorkerPool *pool) {
+    StageTimes times;
+    const xec::KeySchedule cipher = xec::KeySchedule::from_cipher<Cipher>();
+    std::ifstream file(input, std::ios::binary);
+    xec::ContainerWriter writer(output, cipher.width, chunk_size);
+    writer.enable_checksums();
+    std::vector<xec::ChunkSlot> batch(pool ? pool->size() : 1);
+    uint64_t sequence = 0;
+    for (bool more = true; more;) {
+        auto start = Clock::now();
+        std::size_t count = 0;
+        for (; count < batch.size(); ++count) {
+            xec::ChunkSlot &slot = batch[count];
+            slot.input.resize(chunk_size);
+            file.read(&slot.input[0], chunk_size);
+            slot.input.resize(file.gcount());
+            if (slot.input.empty()) {
+                more = false;
+                break;
+            }
+        }
+        times.read += seconds_since(start);
+
+        start = Clock::now();
+        for_each_chunk(batch, count, pool, [&cipher](xec::ChunkSlot &slot) { xec::encrypt_chunk(cipher, slot.input, slot.output, slot.checksum); });
+        times.cipher += seconds_since(start);
+
+        start = Clock::now();
+        for (std::size_t i = 0; i < count; ++i) {
+            writer.write_chunk(sequence++, batch[i].output, batch[i].input.size(), batch[i].checksum);
+        }
+        times.write += seconds_since(start);
+    }
+    auto start = Clock::now();
+    writer.finish();
+    times.write += seconds_since(start);
+    return times;
+}
+
+// Function to decrypt a container with read, cipher (the engines' decrypt_chunk()) and write
+// timed separately
+template <typename Cipher>
+StageTimes run_decrypt_stages(const std::string &input, const std::string &output, xec::WorkerPool *pool) {
+    StageTimes times;
+    xec::ContainerReader reader(input);
+    std::ofstream file(output, std::ios::binary | std::ios::trunc);
+    xec::ChunkVerifier verifier(reader.has_checksums(), reader.chunk_count());
+    std::vector<xec::ChunkSlot> batch(pool ? pool->size() : 1);
+    for (uint64_t next = 0; next < reader.chunk_count();) {
+        auto start = Clock::now();
+        std::size_t count = 0;
+        for (; count < batch.size() && next < reader.chunk_count(); ++count, ++next) {
+            reader.read_chunk(next, batch[count].input);
+            batch[count].sequence = next;
+        }
+        times.read += seconds_since(start);
+
+        start = Clock::now();
+        for_each_chunk(batch, count, pool, [&reader, &verifier](xec::ChunkSlot &slot) {
+            uint32_t expected = verifier.enabled() ? reader.checksum(slot.sequence) : 0;
+            xec::decrypt_chunk(Cipher(), slot.input, reader.entry(slot.sequence).plain_size, slot.output, verifier, slot.sequence, expected);
+        });
+        times.cipher += seconds_since(start);
+
+        start = Clock::now();
+        for (std::size_t i = 0; i < count; ++i) {
+            file.write(batch[i].output.data(), batch[i].output.size());
+        }
+        times.write += seconds_since(start);
+    }
+    auto start = Clock::now();
+    file.flush();
+    times.write += seconds_since(start);
+    check_chunks(verifier.report(std::cerr, input), input);
+    return times;
+}
+
+// Ring depth of the pipeline runs: the binaries' default of two chunks per worker, or
+// the four of XecLDS_SDS / XEC_Dec_LDS for the sequential engine
+std::size_t pipeline_in_flight(const xec::WorkerPool *pool) {
+    return pool ? 2 * pool->size() : 4;
+}
+
+// Function to time the overlapped streaming encrypt engine (ParaEn, or XecLDS_SDS without a pool)
+// end to end, with ifstream/ofstream or (uring_io) io_uring chunk reads and payload writes
+template <typename Cipher>
+double run_encrypt_pipeline(const std::string &input, const std::string &output, std::size_t chunk_size, xec::WorkerPool *pool,
+                            xec::SteadyAllocations &steady, NodeThroughput &nodes, bool uring_io = false) {
+    auto start = Clock::now();
+    xec::CipherStats stats(pool);
+    xec::encrypt_file_in_chunks(xec::KeySchedule::from_cipher<Cipher>(), input, output, "", chunk_size, pool, pipeline_in_flight(pool), uring_io,
+                                nullptr, stats, 0, &steady);
+    double elapsed = seconds_since(start);
+    nodes.add(stats, elapsed);
+    return elapsed;
+}
+
+// Function to time the overlapped streaming decrypt engine (ParaDec, or XEC_Dec_LDS without a pool)
+// end to end
+template <typename Cipher>
+double run_decrypt_pipeline(const std::string &input, const std::string &output, xec::WorkerPool *pool, xec::SteadyAllocations &steady,
+                            NodeThroughput &nodes) {
+    auto start = Clock::now();
+    xec::CipherStats stats(pool);
+    std::size_t failed = xec::decrypt_file_in_chunks(Cipher(), input, output, pool, pipeline_in_flight(pool), stats, &steady);
+    double elapsed = seconds_since(start);
+    check_chunks(failed, input);
+    nodes.add(stats, elapsed);
+    return elapsed;
+}
+
+// Function to time the zero-copy mapped encrypt engine (ParaEn --io mmap) end to end
+template <typename Cipher>
+double run_encrypt_mapped(const std::string &input, const std::string &output, std::size_t chunk_size, xec::WorkerPool &pool) {
+    auto start = Clock::now();
+    xec::CipherStats stats(&pool);
+    xec::encrypt_file_mapped(xec::KeySchedule::from_cipher<Cipher>(), input, output, chunk_size, &pool, stats);
+    return seconds_since(start);
+}
+
+// Function to time the zero-copy mapped decrypt engine (ParaDec --io mmap) end to end
+template <typename Cipher>
+double run_decrypt_mapped(const std::string &input, const std::string &output, xec::WorkerPool &pool) {
+    auto start = Clock::now();
+    xec::CipherStats stats(&pool);
+    std::size_t failed = xec::decrypt_file_mapped(Cipher(), input, output, &pool, stats);
+    double elapsed = seconds_since(start);
+    check_chunks(failed, input);
+    return elapsed;
+}
+
+// One configuration tried by the auto-tuner, with its median encrypt and decrypt times
+struct TuneCandidate {
+    std::size_t threads;
+    std::size_t chunk_size;
+    std::string io;
+    double encrypt_s = 0.0;
+    double decrypt_s = 0.0;
+
+    // Plaintext bytes per second through an encrypt followed by a decrypt
+    double score(uint64_t size) const { return encrypt_s + decrypt_s > 0 ? size / (encrypt_s + decrypt_s) : 0.0; }
+};
+
+// Function to time one candidate's parallel encrypt and decrypt on `input`, with the binaries'
+// default of two chunks in flight per worker; uring covers encryption only (ParaDec has no uring path)
+template <typename Cipher>
+void time_candidate(const BenchOptions &options, const xec::CpuTopology *topology, const std::string &input, TuneCandidate &candidate) {
+    xec::WorkerPool pool(candidate.threads, topology);
+    std::string container = input + ".xec", decrypted = input + ".dec";
+    std::vector<double> encrypt, decrypt;
+    for (std::size_t run = 0; run < options.warmup + options.runs; ++run) {
+        xec::SteadyAllocations steady;
+        NodeThroughput nodes;
+        double encrypt_s, decrypt_s;
+        if (candidate.io == "mmap") {
+            encrypt_s = run_encrypt_mapped<Cipher>(input, container, candidate.chunk_size, pool);
+            decrypt_s = run_decrypt_mapped<Cipher>(container, decrypted, pool);
+        } else {
+            encrypt_s = run_encrypt_pipeline<Cipher>(input, container, candidate.chunk_size, &pool, steady, nodes, candidate.io == "uring");
+            decrypt_s = run_decrypt_pipeline<Cipher>(container, decrypted, &pool, steady, nodes);
+        }
+        if (run >= options.warmup) {
+            encrypt.push_back(encrypt_s);
+            decrypt.push_back(decrypt_s);
+        }
+    }
+    candidate.encrypt_s = summarize(encrypt).median;
+    candidate.decrypt_s = summarize(decrypt).median;
+}
+
+// Function to calibrate this host on the largest --sizes input, written to --dir so the storage
+// measured is the storage the binaries will use. One axis is searched at a time, each starting
+// from the best so far: thread counts 1, 2, 4, ... up to the hardware threads (or --threads) with
+// 1 MB chunks and stream I/O, then chunk sizes 256K-16M, then the I/O backends. The candidate
+// with the highest encrypt+decrypt throughput is written to options.tune_path.
+template <typename Cipher>
+void tune(const BenchOptions &options) {
+    uint64_t size = *std::max_element(options.sizes.begin(), options.sizes.end());
+    std::string input = options.dir + "/tune_" + format_size(size) + ".txt";
+    generate_dataset(input, size, options.seed, options.pattern);
+    xec::CpuTopology topology;
+    if (options.numa) {
+        topology = xec::CpuTopology::detect();
+    }
+    const xec::CpuTopology *pin_to = options.numa ? &topology : nullptr;
+    std::size_t max_threads = options.threads ? options.threads : xec::WorkerPool(0, pin_to).size();
+
+    std::cout << std::setw(10) << "Threads" << std::setw(10) << "Chunk" << std::setw(8) << "I/O"
+              << std::setw(24) << "Encrypt (Bytes/sec)" << std::setw(24) << "Decrypt (Bytes/sec)"
+              << std::setw(24) << "Combined (Bytes/sec)" << "\n";
+    TuneCandidate best{1, 1048576, "stream"};
+    auto try_candidate = [&](TuneCandidate candidate) {
+        time_candidate<Cipher>(options, pin_to, input, candidate);
+        std::cout << std::setw(10) << candidate.threads << std::setw(10) << format_size(candidate.chunk_size) << std::setw(8) << candidate.io
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(24) << size / candidate.encrypt_s << std::setw(24) << size / candidate.decrypt_s
+                  << std::setw(24) << candidate.score(size) << std::endl;
+        if (best.encrypt_s == 0.0 || candidate.score(size) > best.score(size)) {
+            best = candidate;
+        }
+    };
+
+    std::vector<std::size_t> thread_counts;
+    for (std::size_t threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+    for (std::size_t threads : thread_counts) {
+        try_candidate({threads, 1048576, "stream"});
+    }
+    const std::size_t threads = best.threads;
+    for (std::size_t chunk_size = 256 * 1024; chunk_size <= 16 * 1048576ull; chunk_size *= 2) {
+        if (chunk_size != 1048576) {
+            try_candidate({threads, chunk_size, "stream"});
+        }
+    }
+    const std::size_t chunk_size = best.chunk_size;
+    try_candidate({threads, chunk_size, "mmap"});
+#ifdef XEC_HAVE_LIBURING
+    try_candidate({threads, chunk_size, "uring"});
+#endif
+
+    xec::TuneProfile profile;
+    profile.threads = best.threads;
+    profile.chunk_size = best.chunk_size;
+    profile.in_flight = 2 * best.threads;
+    profile.io = best.io;
+    profile.save(options.tune_path, "Bench --tune: " + format_size(size) + " " + options.pattern + " input in " + options.dir + ", " +
+                                    std::to_string(max_threads) + " threads max, " + xec::active_kernel().name + " kernel");
+    std::cout << "\nBest: " << best.threads << " threads, " << format_size(best.chunk_size) << " chunks, " << best.io << " I/O ("
+              << std::fixed << std::setprecision(2) << best.score(size) << " Bytes/sec); wrote " << options.tune_path << "\n";
+}
+
+struct BenchResult {
+    std::string engine;
+    std::string direction;
+    uint64_t size;
+    std::vector<StageTimes> runs;
+    xec::SteadyAllocations steady;   // pipeline runs only, measured runs only
+    NodeThroughput nodes;       // pipeline runs only, measured runs only
+};
+
+template <typename Cipher>
+void bench_size(const BenchOptions &options, uint64_t size, xec::WorkerPool &pool, std::vector<BenchResult> &results) {
+    std::string base = options.dir + "/synthetic_" + format_size(size);
+    generate_dataset(base + ".txt", size, options.seed, options.pattern);
+
+    const char *engines[] = {"sequential", "parallel"};
+    for (const char *engine : engines) {
+        xec::WorkerPool *engine_pool = std::strcmp(engine, "parallel") == 0 ? &pool : nullptr;
+        BenchResult encrypt{engine, "encrypt", size, {}, {}, {}};
+        BenchResult decrypt{engine, "decrypt", size, {}, {}, {}};
+        for (std::size_t run = 0; run < options.warmup + options.runs; ++run) {
+            xec::SteadyAllocations warmup;
+            NodeThroughput warmup_nodes;
+            bool measured = run >= options.warmup;
+            StageTimes enc = run_encrypt_stages<Cipher>(base + ".txt", base + ".xec", options.chunk_size, engine_pool);
+            enc.pipeline = run_encrypt_pipeline<Cipher>(base + ".txt", base + ".xec", options.chunk_size, engine_pool,
+                                                        measured ? encrypt.steady : warmup, measured ? encrypt.nodes : warmup_nodes);
+            if (options.compare_io) {
+                enc.pipeline_uring = run_encrypt_pipeline<Cipher>(base + ".txt", base + ".xec", options.chunk_size, engine_pool, warmup,
+                                                                  warmup_nodes, true);
+            }
+            StageTimes dec = run_decrypt_stages<Cipher>(base + ".xec", base + ".dec", engine_pool);
+            dec.pipeline = run_decrypt_pipeline<Cipher>(base + ".xec", base + ".dec", engine_pool, measured ? decrypt.steady : warmup,
+                                                        measured ? decrypt.nodes : warmup_nodes);
+            if (measured) {
+                encrypt.runs.push_back(enc);
+                decrypt.runs.push_back(dec);
+            }
+        }
+        results.push_back(encrypt);
+        results.push_back(decrypt);
+    }
+}
+
+// Function to gather one stage's latency samples across the measured runs
+std::vector<double> stage_samples(const BenchResult &result, double StageTimes::*stage) {
+    std::vector<double> samples;
+    for (const auto &run : result.runs) {
+        samples.push_back(run.*stage);
+    }
+    return samples;
+}
+
+// Function to tell whether a stage ran at all (pipeline_uring only runs for encrypt with --io compare)
+bool stage_measured(const BenchResult &result, double StageTimes::*stage) {
+    for (const auto &run : result.runs) {
+        if (run.*stage > 0.0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::pair<const char *, double StageTimes::*> STAGES[] = {
+    {"read", &StageTimes::read},
+    {"cipher", &StageTimes::cipher},
+    {"write", &StageTimes::write},
+    {"pipeline", &StageTimes::pipeline},
+#ifdef XEC_HAVE_LIBURING
+    {"pipeline_uring", &StageTimes::pipeline_uring},
+#endif
+};
+
+// Function to tell whether a result has steady-state allocation counts (the file needs more
+// than two chunks per ring slot, and the build must count allocations)
+bool allocations_measured(const BenchResult &result) {
+    return xec::allocation_counting_enabled() && result.steady.chunks > 0;
+}
+
+double allocations_per_chunk(const BenchResult &result) {
+    return static_cast<double>(result.steady.allocations) / result.steady.chunks;
+}
+
+void print_results(const std::vector<BenchResult> &results, bool numa) {
+    std::cout << std::setw(12) << "Engine" << std::setw(10) << "Dir" << std::setw(8) << "Size"
+              << std::setw(16) << "Stage"
+              << std::setw(16) << "Median (s)" << std::setw(16) << "p95 (s)" << std::setw(16) << "p99 (s)"
+              << std::setw(22) << "Median (Bytes/sec)" << std::setw(22) << "p99 (Bytes/sec)" << "\n";
+    for (const auto &result : results) {
+        for (const auto &stage : STAGES) {
+            if (!stage_measured(result, stage.second)) {
+                continue;
+            }
+            Summary latency = summarize(stage_samples(result, stage.second));
+            std::cout << std::setw(12) << result.engine << std::setw(10) << result.direction
+                      << std::setw(8) << format_size(result.size) << std::setw(16) << stage.first
+                      << std::fixed << std::setprecision(6)
+                      << std::setw(16) << latency.median << std::setw(16) << latency.p95 << std::setw(16) << latency.p99
+                      << std::setprecision(2)
+                      << std::setw(22) << (latency.median > 0 ? result.size / latency.median : 0.0)
+                      << std::setw(22) << (latency.p99 > 0 ? result.size / latency.p99 : 0.0) << "\n";
+        }
+    }
+
+    if (numa) {
+        std::cout << "\n" << std::setw(12) << "Engine" << std::setw(10) << "Dir" << std::setw(8) << "Size"
+                  << std::setw(16) << "Node" << std::setw(22) << "Pipeline (Bytes/sec)" << "\n";
+        for (const auto &result : results) {
+            if (result.engine != "parallel") {
+                continue;
+            }
+            for (std::size_t node = 0; node < result.nodes.bytes.size(); ++node) {
+                std::cout << std::setw(12) << result.engine << std::setw(10) << result.direction
+                          << std::setw(8) << format_size(result.size) << std::setw(16) << node
+                          << std::fixed << std::setprecision(2) << std::setw(22) << result.nodes.rate(node) << "\n";
+            }
+        }
+    }
+
+    if (!xec::allocation_counting_enabled()) {
+        return;
+    }
+    std::cout << "\n" << std::setw(12) << "Engine" << std::setw(10) << "Dir" << std::setw(8) << "Size"
+              << std::setw(16) << "Chunks" << std::setw(32) << "Heap allocs/chunk (steady)" << "\n";
+    for (const auto &result : results) {
+        if (!allocations_measured(result)) {
+            continue;
+        }
+        std::cout << std::setw(12) << result.engine << std::setw(10) << result.direction
+                  << std::setw(8) << format_size(result.size) << std::setw(16) << result.steady.chunks
+                  << std::fixed << std::setprecision(4) << std::setw(32) << allocations_per_chunk(result) << "\n";
+    }
+}
+
+// Function to write the results as JSON; throughput percentiles are computed per run, so
+// throughput p95/p99 are the slow tail (5th/1st percentile of bytes per second)
+void write_json(const std::string &filename, const BenchOptions &options, const xec::WorkerPool &pool, const std::vector<BenchResult> &results) {
+    std::ofstream out(filename);
+    if (!out) {
+        throw std::runtime_error("Cannot open output file: " + filename);
+    }
+    out << std::setprecision(9);
+    out << "{\n  \"label\": \"" << options.label << "\",\n"
+        << "  \"container_version\": " << xec::CONTAINER_VERSION << ",\n"
+        << "  \"kernel\": \"" << xec::active_kernel().name << "\",\n"
+        << "  \"threads\": " << pool.size() << ",\n"
+        << "  \"numa_nodes\": " << pool.node_count() << ",\n"
+        << "  \"pinned\": " << (options.numa ? "true" : "false") << ",\n"
+        << "  \"chunk_size\": " << options.chunk_size << ",\n"
+        << "  \"segment_bits\": " << options.width << ",\n"
+        << "  \"pattern\": \"" << options.pattern << "\",\n"
+        << "  \"seed\": " << options.seed << ",\n"
+        << "  \"runs\": " << options.runs << ",\n"
+        << "  \"warmup\": " << options.warmup << ",\n"
+        << "  \"allocation_counting\": " << (xec::allocation_counting_enabled() ? "true" : "false") << ",\n"
+        << "  \"results\": [";
+    bool first = true;
+    for (const auto &result : results) {
+        for (const auto &stage : STAGES) {
+            if (!stage_measured(result, stage.second)) {
+                continue;
+            }
+            std::vector<double> samples = stage_samples(result, stage.second);
+            Summary latency = summarize(samples);
+            std::vector<double> rates;
+            for (double s : samples) {
+                rates.push_back(s > 0 ? -(result.size / s) : 0.0); // negated so the tail sorts high
+            }
+            Summary rate = summarize(rates);
+            out << (first ? "\n" : ",\n")
+                << "    {\"engine\": \"" << result.engine << "\", \"direction\": \"" << result.direction
+                << "\", \"size\": " << result.size << ", \"stage\": \"" << stage.first << "\""
+                << ", \"latency_s\": {\"median\": " << latency.median << ", \"p95\": " << latency.p95 << ", \"p99\": " << latency.p99 << "}"
+                << ", \"throughput_Bps\": {\"median\": " << -rate.median << ", \"p95\": " << -rate.p95 << ", \"p99\": " << -rate.p99 << "}";
+            if (stage.second == &StageTimes::pipeline && allocations_measured(result)) {
+                out << ", \"allocations_per_chunk\": " << allocations_per_chunk(result);
+            }
+            if (stage.second == &StageTimes::pipeline && options.numa && result.engine == "parallel") {
+                out << ", \"node_throughput_Bps\": [";
+                for (std::size_t node = 0; node < result.nodes.bytes.size(); ++node) {
+                    out << (node ? ", " : "") << result.nodes.rate(node);
+                }
+                out << "]";
+            }
+            out << "}";
+            first = false;
+        }
+    }
+    out << "\n  ]\n}\n";
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--sizes") {
+            options.sizes.clear();
+            for (std::size_t start = 0; start <= value.size();) {
+                std::size_t end = value.find(',', start);
+                options.sizes.push_back(parse_size(value.substr(start, end - start)));
+                start = end == std::string::npos ? value.size() + 1 : end + 1;
+            }
+        } else if (flag == "--runs") {
+            options.runs = std::stoul(value);
+        } else if (flag == "--warmup") {
+            options.warmup = std::stoul(value);
+        } else if (flag == "--threads") {
+            options.threads = std::stoul(value);
+        } else if (flag == "--chunk-size") {
+            options.chunk_size = parse_size(value);
+        } else if (flag == "--width") {
+            options.width = std::stoul(value);
+        } else if (flag == "--pattern") {
+            options.pattern = value;
+        } else if (flag == "--seed") {
+            options.seed = std::stoull(value);
+        } else if (flag == "--dir") {
+            options.dir = value;
+        } else if (flag == "--json") {
+            options.json_path = value;
+        } else if (flag == "--label") {
+            options.label = value;
+        } else if (flag == "--tune") {
+            options.tune_path = value;
+        } else if (flag == "--numa") {
+            options.numa = value == "on";
+        } else if (flag == "--io") {
+            options.compare_io = value == "compare";
+#ifndef XEC_HAVE_LIBURING
+            if (options.compare_io) {
+                std::cerr << "Built without liburing; --io compare is unavailable" << std::endl;
+                return 1;
+            }
+#endif
+        } else {
+            std::cerr << "Unknown option " << flag << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        std::filesystem::create_directories(options.dir);
+        if (!options.tune_path.empty()) {
+            if (options.width == 128) {
+                tune<xec::XecCipher128>(options);
+            } else {
+                tune<xec::XecCipher256>(options);
+            }
+            return 0;
+        }
+        xec::CpuTopology topology;
+        if (options.numa) {
+            topology = xec::CpuTopology::detect();
+        }
+        xec::WorkerPool pool(options.threads, options.numa ? &topology : nullptr);
+        std::vector<BenchResult> results;
+        for (uint64_t size : options.sizes) {
+            if (options.width == 128) {
+                bench_size<xec::XecCipher128>(options, size, pool, results);
+            } else {
+                bench_size<xec::XecCipher256>(options, size, pool, results);
+            }
+        }
+        print_results(results, options.numa);
+        if (!options.json_path.empty()) {
+            write_json(options.json_path, options, pool, results);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
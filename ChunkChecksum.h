@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "SegmentKernel.h"
+
+// Per-chunk CRC-32C (Castagnoli) integrity checksums, computed in the cipher pass.
+//
+// Every container chunk carries the CRC-32C of its ciphertext payload (see CipherContainer.h).
+// encrypt_padded_checked() and decrypt_checked() walk a chunk in 4 KB blocks and checksum each
+// block right after (encrypt) or right before (decrypt) the mask is applied, while it is still
+// in L1, so verification costs no extra pass over memory. The payload is checksummed as three
+// interleaved lanes so the CPU's crc32 instruction (SSE4.2) keeps three independent chains in
+// flight instead of waiting on one; the lane CRCs are joined once per chunk by a GF(2) shift.
+// Without SSE4.2, or with XEC_KERNEL=scalar, a byte table computes the same values.
+namespace xec {
+
+namespace crc {
+
+constexpr uint32_t CASTAGNOLI = 0x82F63B78u; // reflected polynomial
+
+// Function to multiply two polynomials modulo the CRC polynomial (reflected bit order)
+inline uint32_t multiply(uint32_t a, uint32_t b) {
+    uint32_t product = 0;
+    for (uint32_t bit = 1u << 31; bit != 0; bit >>= 1) {
+        if (a & bit) {
+            product ^= b;
+        }
+        b = (b & 1) ? (b >> 1) ^ CASTAGNOLI : b >> 1;
+    }
+    return product;
+}
+
+// Function to compute x^(8 * bytes) modulo the CRC polynomial, i.e. the operator that advances a
+// CRC register over `bytes` zero bytes
+inline uint32_t shift_operator(uint64_t bytes) {
+    static const std::vector<uint32_t> powers = [] {
+        std::vector<uint32_t> table(64);
+        table[0] = 1u << 30; // x^1
+        for (std::size_t k = 1; k < table.size(); ++k) {
+            table[k] = multiply(table[k - 1], table[k - 1]); // x^(2^k)
+        }
+        return table;
+    }();
+    uint32_t result = 1u << 31; // x^0
+    for (std::size_t k = 3; bytes != 0; bytes >>= 1, ++k) {
+        if (bytes & 1) {
+            result = multiply(powers[k], result);
+        }
+    }
+    return result;
+}
+
+inline const uint32_t *byte_table() {
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t byte = 0; byte < 256; ++byte) {
+            uint32_t value = byte;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? (value >> 1) ^ CASTAGNOLI : value >> 1;
+            }
+            t[byte] = value;
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+// Raw register updates (no pre/post inversion) over one lane, or three equal-length lanes
+inline uint32_t update_scalar(uint32_t reg, const uint8_t *p, std::size_t size) {
+    const uint32_t *table = byte_table();
+    for (std::size_t i = 0; i < size; ++i) {
+        reg = table[(reg ^ p[i]) & 0xFF] ^ (reg >> 8);
+    }
+    return reg;
+}
+
+inline void update3_scalar(uint32_t *reg, const uint8_t *a, const uint8_t *b, const uint8_t *c, std::size_t size) {
+    reg[0] = update_scalar(reg[0], a, size);
+    reg[1] = update_scalar(reg[1], b, size);
+    reg[2] = update_scalar(reg[2], c, size);
+}
+
+#ifdef XEC_KERNEL_X86
+__attribute__((target("sse4.2")))
+inline uint32_t update_sse42(uint32_t reg, const uint8_t *p, std::size_t size) {
+    uint64_t value = reg;
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, p + i, 8);
+        value = _mm_crc32_u64(value, word);
+    }
+    uint32_t tail = static_cast<uint32_t>(value);
+    for (; i < size; ++i) {
+        tail = _mm_crc32_u8(tail, p[i]);
+    }
+    return tail;
+}
+
+// `size` must be a multiple of 8 (lanes are whole 64-byte blocks)
+__attribute__((target("sse4.2")))
+inline void update3_sse42(uint32_t *reg, const uint8_t *a, const uint8_t *b, const uint8_t *c, std::size_t size) {
+    uint64_t ra = reg[0], rb = reg[1], rc = reg[2];
+    for (std::size_t i = 0; i < size; i += 8) {
+        uint64_t wa, wb, wc;
+        std::memcpy(&wa, a + i, 8);
+        std::memcpy(&wb, b + i, 8);
+        std::memcpy(&wc, c + i, 8);
+        ra = _mm_crc32_u64(ra, wa);
+        rb = _mm_crc32_u64(rb, wb);
+        rc = _mm_crc32_u64(rc, wc);
+    }
+    reg[0] = static_cast<uint32_t>(ra);
+    reg[1] = static_cast<uint32_t>(rb);
+    reg[2] = static_cast<uint32_t>(rc);
+}
+#endif
+
+struct CrcKernel {
+    uint32_t (*update)(uint32_t, const uint8_t *, std::size_t);
+    void (*update3)(uint32_t *, const uint8_t *, const uint8_t *, const uint8_t *, std::size_t);
+    const char *name;
+};
+
+// Function to pick the crc32 instruction when the CPU has it; XEC_KERNEL=scalar forces the table
+inline CrcKernel select_crc_kernel() {
+    const char *forced = std::getenv("XEC_KERNEL");
+#ifdef XEC_KERNEL_X86
+    __builtin_cpu_init();
+    if (!(forced && std::strcmp(forced, "scalar") == 0) && __builtin_cpu_supports("sse4.2")) {
+        return {update_sse42, update3_sse42, "sse4.2"};
+    }
+#endif
+    (void)forced;
+    return {update_scalar, update3_scalar, "table"};
+}
+
+inline const CrcKernel &active_crc_kernel() {
+    static const CrcKernel kernel = select_crc_kernel();
+    return kernel;
+}
+
+// Bytes handled per step of the fused loops: small enough that a block is still in L1 when it is
+// checksummed, a multiple of MASK_BLOCK_BYTES so every block starts on a segment boundary
+constexpr std::size_t FUSED_BLOCK_BYTES = 4096;
+
+} // namespace crc
+
+// Function to compute the CRC-32C of `size` bytes
+inline uint32_t crc32c(const uint8_t *data, std::size_t size) {
+    return ~crc::active_crc_kernel().update(~0u, data, size);
+}
+
+// Function to return the CRC-32C of data[0, size) while calling before(offset, length) ahead of
+// checksumming each block and after(offset, length) behind it. Blocks start on 64-byte boundaries
+// and together cover [0, size) exactly once.
+template <typename Before, typename After>
+uint32_t crc32c_fused(const uint8_t *data, std::size_t size, Before before, After after) {
+    const crc::CrcKernel &kernel = crc::active_crc_kernel();
+    const std::size_t lane = size / 3 / MASK_BLOCK_BYTES * MASK_BLOCK_BYTES;
+    uint32_t reg = ~0u;
+    std::size_t done = 0;
+    if (lane >= crc::FUSED_BLOCK_BYTES) {
+        uint32_t lanes[3] = {reg, 0, 0};
+        for (std::size_t offset = 0; offset < lane; offset += crc::FUSED_BLOCK_BYTES) {
+            std::size_t length = std::min(crc::FUSED_BLOCK_BYTES, lane - offset);
+            for (std::size_t l = 0; l < 3; ++l) {
+                before(l * lane + offset, length);
+            }
+            kernel.update3(lanes, data + offset, data + lane + offset, data + 2 * lane + offset, length);
+            for (std::size_t l = 0; l < 3; ++l) {
+                after(l * lane + offset, length);
+            }
+        }
+        uint32_t advance = crc::shift_operator(lane);
+        reg = crc::multiply(advance, crc::multiply(advance, lanes[0]) ^ lanes[1]) ^ lanes[2];
+        done = 3 * lane;
+    }
+    for (; done < size; done += crc::FUSED_BLOCK_BYTES) {
+        std::size_t length = std::min(crc::FUSED_BLOCK_BYTES, size - done);
+        before(done, length);
+        reg = kernel.update(reg, data + done, length);
+        after(done, length);
+    }
+    return ~reg;
+}
+
+// Function to encrypt_padded() `size` plaintext bytes and return the CRC-32C of the padded ciphertext
+template <typename Cipher>
+uint32_t encrypt_padded_checked(const Cipher &cipher, const uint8_t *in, uint8_t *out, std::size_t size) {
+    return crc32c_fused(out, cipher.padded_size(size),
+        [&](std::size_t offset, std::size_t length) {
+            // Only the chunk's last block can hold the partial segment, and it ends the payload
+            if (offset + length <= size) {
+                cipher.encrypt(in + offset, out + offset, length);
+            } else {
+                cipher.encrypt_padded(in + offset, out + offset, size - offset);
+            }
+        },
+        [](std::size_t, std::size_t) {});
+}
+
+template <typename Cipher>
+uint32_t encrypt_padded_checked(const Cipher &cipher, const char *in, char *out, std::size_t size) {
+    return encrypt_padded_checked(cipher, reinterpret_cast<const uint8_t *>(in), reinterpret_cast<uint8_t *>(out), size);
+}
+
+// Function to decrypt the first `plain_size` bytes of a `payload_size`-byte payload and return the
+// CRC-32C of the whole payload; each block is checksummed before it is decrypted, so in may equal out
+template <typename Cipher>
+uint32_t decrypt_checked(const Cipher &cipher, const uint8_t *in, uint8_t *out, std::size_t plain_size, std::size_t payload_size) {
+    return crc32c_fused(in, payload_size,
+        [](std::size_t, std::size_t) {},
+        [&](std::size_t offset, std::size_t length) {
+            if (offset < plain_size) {
+                cipher.decrypt(in + offset, out + offset, std::min(length, plain_size - offset));
+            }
+        });
+}
+
+template <typename Cipher>
+uint32_t decrypt_checked(const Cipher &cipher, const char *in, char *out, std::size_t plain_size, std::size_t payload_size) {
+    return decrypt_checked(cipher, reinterpret_cast<const uint8_t *>(in), reinterpret_cast<uint8_t *>(out), plain_size, payload_size);
+}
+
+// Chunks of one file whose payload failed its checksum. Each chunk index is checked by exactly one
+// task, so workers record into distinct bytes without locking.
+class ChunkVerifier {
+public:
+    // `enabled` is false for containers written without checksums; nothing is checked then
+    ChunkVerifier(bool enabled, uint64_t chunk_count) : enabled_(enabled), failed_(enabled ? chunk_count : 0, 0) {}
+
+    bool enabled() const { return enabled_; }
+
+    // Function to record whether chunk `index` verified; returns false if it is corrupt
+    bool check(uint64_t index, uint32_t actual, uint32_t expected) {
+        if (actual != expected) {
+            failed_[index] = 1;
+            return false;
+        }
+        return true;
+    }
+
+    // Function to print one line per corrupt chunk of `filename` to `out`; returns how many failed
+    std::size_t report(std::ostream &out, const std::string &filename) const {
+        std::size_t count = 0;
+        for (std::size_t index = 0; index < failed_.size(); ++index) {
+            if (failed_[index]) {
+                out << "Corrupt chunk " << index << " in " << filename << ": CRC-32C mismatch" << std::endl;
+                ++count;
+            }
+        }
+        return count;
+    }
+
+private:
+    bool enabled_;
+    std::vector<uint8_t> failed_;
+};
+
+} // namespace xec
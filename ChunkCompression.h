@@ -0,0 +1,243 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "ChunkChecksum.h"
+#include "CipherContainer.h"
+#include "WorkerPool.h"
+
+#ifdef XEC_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Optional per-chunk compression ahead of the cipher (--compress LEVEL).
+//
+// Each chunk is deflated on its own (raw RFC 1951 stream, zlib level 1-9) and the deflate stream
+// is encrypted in place of the plaintext, so chunks still compress, encrypt, decrypt and
+// inflate in parallel and a plaintext offset still maps to one chunk. The stream ends itself,
+// so the zero padding of the last segment is never inflated and the index needs no compressed
+// length. Every worker keeps its own deflate/inflate state, reset per chunk, so the steady
+// state allocates nothing.
+//
+// Compiled in only when XEC_HAVE_ZLIB is defined (build with -DXEC_HAVE_ZLIB -lz); otherwise
+// the encryptors write uncompressed containers and the decryptors reject compressed ones.
+namespace xec {
+
+#ifdef XEC_HAVE_ZLIB
+constexpr bool COMPRESSION_AVAILABLE = true;
+#else
+constexpr bool COMPRESSION_AVAILABLE = false;
+#endif
+
+// Deflate and inflate state of one thread, plus a buffer for decrypting a payload before inflating it
+class ChunkCodec {
+public:
+    explicit ChunkCodec(int level) : level_(level) {}
+
+    ~ChunkCodec() {
+#ifdef XEC_HAVE_ZLIB
+        if (deflating_) {
+            deflateEnd(&deflate_);
+        }
+        if (inflating_) {
+            inflateEnd(&inflate_);
+        }
+#endif
+    }
+
+    ChunkCodec(const ChunkCodec &) = delete;
+    ChunkCodec &operator=(const ChunkCodec &) = delete;
+
+    // Largest deflate stream `size` bytes can compress to
+    static std::size_t bound(std::size_t size) {
+#ifdef XEC_HAVE_ZLIB
+        return compressBound(static_cast<uLong>(size));
+#else
+        return size;
+#endif
+    }
+
+    // Function to deflate `size` bytes into `out` (room for bound(size) bytes); returns the stream length
+    std::size_t compress(const uint8_t *in, std::size_t size, uint8_t *out) {
+#ifdef XEC_HAVE_ZLIB
+        check_length(size);
+        if (!deflating_) {
+            std::memset(&deflate_, 0, sizeof(deflate_));
+            if (deflateInit2(&deflate_, level_, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                throw std::runtime_error("Cannot initialise deflate at level " + std::to_string(level_));
+            }
+            deflating_ = true;
+        } else {
+            deflateReset(&deflate_);
+        }
+        deflate_.next_in = const_cast<Bytef *>(in);
+        deflate_.avail_in = static_cast<uInt>(size);
+        deflate_.next_out = out;
+        deflate_.avail_out = static_cast<uInt>(bound(size));
+        if (deflate(&deflate_, Z_FINISH) != Z_STREAM_END) {
+            throw std::runtime_error("Deflate did not finish a chunk");
+        }
+        return deflate_.total_out;
+#else
+        (void)in, (void)size, (void)out;
+        unavailable();
+#endif
+    }
+
+    // Function to inflate the first `size` bytes of a chunk from its deflate stream `in` (trailing
+    // padding is ignored); with `whole` set `size` is the chunk's full length and the stream must end there
+    void decompress(const uint8_t *in, std::size_t in_size, uint8_t *out, std::size_t size, bool whole) {
+#ifdef XEC_HAVE_ZLIB
+        check_length(in_size);
+        check_length(size);
+        if (!inflating_) {
+            std::memset(&inflate_, 0, sizeof(inflate_));
+            if (inflateInit2(&inflate_, -MAX_WBITS) != Z_OK) {
+                throw std::runtime_error("Cannot initialise inflate");
+            }
+            inflating_ = true;
+        } else {
+            inflateReset(&inflate_);
+        }
+        inflate_.next_in = const_cast<Bytef *>(in);
+        inflate_.avail_in = static_cast<uInt>(in_size);
+        inflate_.next_out = out;
+        inflate_.avail_out = static_cast<uInt>(size);
+        int rc = inflate(&inflate_, Z_FINISH);
+        bool ended = rc == Z_STREAM_END;
+        bool filled = inflate_.total_out == size && (rc == Z_OK || rc == Z_BUF_ERROR);
+        if (!(whole ? ended && inflate_.total_out == size : ended || filled)) {
+            throw std::runtime_error("Compressed chunk does not inflate to its recorded length");
+        }
+#else
+        (void)in, (void)in_size, (void)out, (void)size, (void)whole;
+        unavailable();
+#endif
+    }
+
+    std::string &scratch() { return scratch_; }
+
+private:
+#ifdef XEC_HAVE_ZLIB
+    static void check_length(std::size_t size) {
+        if (size > UINT_MAX) {
+            throw std::runtime_error("Chunk too large to compress: " + std::to_string(size) + " bytes");
+        }
+    }
+
+    z_stream deflate_;
+    z_stream inflate_;
+    bool deflating_ = false;
+    bool inflating_ = false;
+#else
+    [[noreturn]] static void unavailable() {
+        throw std::runtime_error("Container is compressed; rebuild with -DXEC_HAVE_ZLIB -lz to read it");
+    }
+#endif
+    int level_;
+    std::string scratch_;
+};
+
+// One ChunkCodec per worker of `pool` plus one for the owning thread, created on first use with
+// `scratch_bytes` of buffer (the largest payload it will decrypt) so later chunks never grow it
+class ChunkCodecs {
+public:
+    ChunkCodecs(const WorkerPool *pool, int level, std::size_t scratch_bytes = 0)
+        : pool_(pool), level_(level), scratch_bytes_(scratch_bytes), codecs_(pool ? pool->size() + 1 : 1) {}
+
+    // Function to return the calling thread's codec; call only from a worker of the pool or the owning thread
+    ChunkCodec &local() {
+        std::unique_ptr<ChunkCodec> &codec = codecs_[pool_ ? pool_->current_worker() : 0];
+        if (!codec) {
+            codec.reset(new ChunkCodec(level_));
+            codec->scratch().reserve(scratch_bytes_);
+        }
+        return *codec;
+    }
+
+private:
+    const WorkerPool *pool_;
+    int level_;
+    std::size_t scratch_bytes_;
+    std::vector<std::unique_ptr<ChunkCodec>> codecs_;
+};
+
+// Function to check a --compress level; zlib levels 1 (fastest) to 9 (smallest)
+inline int parse_compress_level(const std::string &text) {
+    int level = std::stoi(text);
+    if (level < 1 || level > 9) {
+        throw std::runtime_error("Compression level must be 1-9, got " + text);
+    }
+    return level;
+}
+
+// Function to deflate a chunk into `out`, sized to the stream rounded up to whole segments, ready to
+// be encrypted in place with encrypt_padded_checked(); returns the stream length
+template <typename Cipher>
+std::size_t compress_chunk(const Cipher &cipher, ChunkCodec &codec, const std::string &chunk, std::string &out) {
+    out.resize(cipher.padded_size(ChunkCodec::bound(chunk.size())));
+    std::size_t stream = codec.compress(reinterpret_cast<const uint8_t *>(chunk.data()), chunk.size(), reinterpret_cast<uint8_t *>(&out[0]));
+    out.resize(cipher.padded_size(stream));
+    return stream;
+}
+
+// Function to decrypt a compressed payload into the codec's buffer and inflate its `plain_size`
+// bytes to `out`, checking the payload's CRC-32C first when `verifier` is enabled. A corrupt
+// chunk is recorded and zero-filled rather than inflated, so the rest of the file still decrypts.
+template <typename Cipher>
+void decrypt_decompress(const Cipher &cipher, ChunkCodec &codec, const uint8_t *payload, std::size_t payload_size, uint8_t *out,
+                        std::size_t plain_size, ChunkVerifier &verifier, uint64_t index, uint32_t expected_checksum) {
+    std::string &stream = codec.scratch();
+    stream.resize(payload_size);
+    uint8_t *decrypted = reinterpret_cast<uint8_t *>(&stream[0]);
+    if (verifier.enabled()) {
+        if (!verifier.check(index, decrypt_checked(cipher, payload, decrypted, payload_size, payload_size), expected_checksum)) {
+            std::memset(out, 0, plain_size);
+            return;
+        }
+    } else {
+        cipher.decrypt(payload, decrypted, payload_size);
+    }
+    codec.decompress(decrypted, payload_size, out, plain_size, true);
+}
+
+// Function to decrypt plaintext bytes [offset, offset + length) of a compressed container: each
+// covering chunk is read and decrypted whole, then inflated only up to the end of the range
+template <typename Cipher>
+void decrypt_compressed_range(ContainerReader &reader, uint64_t offset, uint64_t length, std::string &plaintext, const Cipher &cipher,
+                              ChunkCodec &codec) {
+    const ContainerHeader &header = reader.header();
+    if (header.segment_bits != cipher.width) {
+        throw std::runtime_error("Expected " + std::to_string(cipher.width) + "-bit segments, container has " + std::to_string(header.segment_bits));
+    }
+    if (offset > header.plaintext_size || length > header.plaintext_size - offset) {
+        throw std::runtime_error("Range " + std::to_string(offset) + "+" + std::to_string(length) +
+                                 " is outside the " + std::to_string(header.plaintext_size) + "-byte plaintext");
+    }
+    plaintext.resize(length);
+    std::string &stream = codec.scratch();
+    std::string chunk;
+    for (uint64_t done = 0; done < length;) {
+        uint64_t index = (offset + done) / header.chunk_size;
+        uint64_t in_chunk = (offset + done) % header.chunk_size;
+        if (index >= reader.chunk_count() || in_chunk >= reader.entry(index).plain_size) {
+            throw std::runtime_error("Chunk index does not cover plaintext offset " + std::to_string(offset + done));
+        }
+        uint64_t take = std::min(length - done, reader.entry(index).plain_size - in_chunk);
+        reader.read_chunk(index, stream);
+        cipher.decrypt(stream.data(), &stream[0], stream.size());
+        chunk.resize(in_chunk + take);
+        codec.decompress(reinterpret_cast<const uint8_t *>(stream.data()), stream.size(), reinterpret_cast<uint8_t *>(&chunk[0]), chunk.size(),
+                         chunk.size() == reader.entry(index).plain_size);
+        std::memcpy(&plaintext[done], chunk.data() + in_chunk, take);
+        done += take;
+    }
+}
+
+} // namespace xec
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "AllocCounter.h"
+#include "ChunkChecksum.h"
+#include "ChunkCompression.h"
+#include "ChunkRing.h"
+#include "CipherContainer.h"
+#include "CipherStats.h"
+#include "KeySchedule.h"
+#include "MappedFile.h"
+#include "StageTimer.h"
+#include "UringIO.h"
+#include "WorkerPool.h"
+
+// File engines of ParaEn / XecLDS_SDS (encrypt) and ParaDec / XEC_Dec_LDS (decrypt), shared with
+// Bench so the timings it reports and the profiles --tune writes come from the code the binaries
+// run.
+//
+// The chunked engines stream a file through read -> cipher -> in-order write on an
+// OrderedChunkRing; the mapped engines map input and output and let the kernel do the I/O.
+// Chunks run on `pool`, or inline on the calling thread when it is null (the sequential
+// binaries). File names are used as given; segment and byte counts go to the caller's `stats`.
+namespace xec {
+
+// Heap allocations a chunked engine made once every ring slot had finished a chunk, and the chunks
+// it processed in that time (reading chunk 2 * capacity means chunks 0..capacity are written)
+struct SteadyAllocations {
+    uint64_t allocations = 0;
+    uint64_t chunks = 0;
+};
+
+// Function to encrypt a chunk into packed ciphertext bytes, zero-padding the last segment, and
+// checksum the ciphertext in the same pass
+inline std::size_t encrypt_chunk(const KeySchedule &cipher, const std::string &chunk, std::string &binary_result, uint32_t &checksum) {
+    binary_result.resize(cipher.padded_size(chunk.size()));
+    checksum = encrypt_padded_checked(cipher, chunk.data(), &binary_result[0], chunk.size());
+    return binary_result.size() / cipher.segment_bytes;
+}
+
+// Function to append one ciphertext chunk as a '0'/'1' text line (debug export only)
+inline void write_text_export(std::ofstream &outfile, const std::string &binary_chunk, std::string &text) {
+    text.clear();
+    append_bits_as_text(binary_chunk, text);
+    outfile << text << "\n";
+}
+
+// Function to decrypt a packed ciphertext chunk straight into its original plaintext bytes in one
+// pass; the padding of the last segment is never decrypted, only its `plain_size` real bytes.
+// When the container has checksums the payload's CRC-32C is computed in the same pass.
+template <typename Cipher>
+void decrypt_chunk(const Cipher &cipher, const std::string &binary_chunk, uint64_t plain_size, std::string &decrypted_chunk,
+                   ChunkVerifier &verifier, uint64_t index, uint32_t expected_checksum) {
+    decrypted_chunk.resize(plain_size);
+    if (verifier.enabled()) {
+        verifier.check(index, decrypt_checked(cipher, binary_chunk.data(), &decrypted_chunk[0], plain_size, binary_chunk.size()), expected_checksum);
+    } else {
+        cipher.decrypt(binary_chunk.data(), &decrypted_chunk[0], plain_size);
+    }
+}
+
+// Function to encrypt a file as a reader -> workers -> in-order container writer pipeline. At
+// most `in_flight` chunks are resident; the reader stalls when the writer falls behind, so files
+// larger than memory encrypt with constant RSS. A non-empty `text_filename` also gets the
+// '0'/'1' text export. With `uring_io` chunk reads and payload writes go through io_uring,
+// `in_flight` deep each way. A non-null `budget` is shared with other files encrypting on the
+// same pool (job mode) and bounds their combined chunk data in flight. A non-zero
+// `compress_level` deflates each chunk at that zlib level before it is encrypted.
+inline void encrypt_file_in_chunks(const KeySchedule &cipher, const std::string &input_filename, const std::string &container_filename,
+                                   const std::string &text_filename, std::size_t chunk_size, WorkerPool *pool, std::size_t in_flight,
+                                   bool uring_io, MemoryBudget *budget, CipherStats &stats, int compress_level,
+                                   SteadyAllocations *steady = nullptr) {
+    std::ifstream file(input_filename, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open file: " + input_filename);
+    }
+
+    ContainerWriter writer(container_filename, cipher.width, chunk_size);
+    writer.set_key_id(cipher.key_id);
+    writer.enable_checksums();
+    writer.reserve_index((std::filesystem::file_size(input_filename) + chunk_size - 1) / chunk_size);
+    std::unique_ptr<ChunkCodecs> codecs;
+    if (compress_level != 0) {
+        codecs.reset(new ChunkCodecs(pool, compress_level));
+        writer.enable_compression();
+    }
+    // Largest payload one chunk can encrypt to; deflate may grow incompressible data slightly
+    const std::size_t payload_bound = cipher.padded_size(codecs ? ChunkCodec::bound(chunk_size) : chunk_size);
+    std::ofstream text_file;
+    std::string text;
+    if (!text_filename.empty()) {
+        text_file.open(text_filename);
+        if (!text_file) {
+            throw std::runtime_error("Cannot open output file");
+        }
+    }
+
+#ifdef XEC_HAVE_LIBURING
+    std::unique_ptr<UringChunkReader> uring_reader;
+    std::unique_ptr<UringChunkWriter> uring_writer;
+    if (uring_io) {
+        uring_reader.reset(new UringChunkReader(input_filename, chunk_size, in_flight));
+        uring_writer.reset(new UringChunkWriter(container_filename, payload_bound, in_flight));
+    }
+#else
+    (void)uring_io;
+#endif
+
+    OrderedChunkRing ring(in_flight);
+    place_chunk_slots(ring, pool, chunk_size, payload_bound);
+
+    // Input plus padded output of one chunk, held against the budget from read until written
+    const uint64_t chunk_footprint = chunk_size + payload_bound;
+    std::atomic<uint64_t> budget_held(0);
+    uint64_t steady_start = 0;
+    auto read_chunk = [&](ChunkSlot &slot) {
+        XEC_TIME_STAGE(Stage::Read);
+#ifdef XEC_HAVE_LIBURING
+        if (uring_reader) {
+            return uring_reader->next(slot.input);
+        }
+#endif
+        slot.input.resize(chunk_size);
+        file.read(&slot.input[0], chunk_size);
+        slot.input.resize(file.gcount());
+        return !slot.input.empty();
+    };
+    auto release_budget = [&](uint64_t bytes) {
+        if (budget && bytes > 0) {
+            budget_held -= bytes;
+            budget->release(bytes);
+        }
+    };
+
+    uint64_t chunks = 0;
+    try {
+        chunks = run_chunk_pipeline(ring, pool,
+            [&](ChunkSlot &slot) {
+                if (steady && slot.sequence == 2 * ring.capacity()) {
+                    steady_start = heap_allocations();
+                }
+                if (budget) {
+                    budget->acquire(chunk_footprint);
+                    budget_held += chunk_footprint;
+                }
+                bool more = read_chunk(slot);
+                if (!more) {
+                    release_budget(chunk_footprint);
+                }
+                return more;
+            },
+            [&](ChunkSlot &slot) {
+                if (codecs) {
+                    std::size_t stream;
+                    {
+                        XEC_TIME_STAGE(Stage::Compress);
+                        stream = compress_chunk(cipher, codecs->local(), slot.input, slot.output);
+                    }
+                    XEC_TIME_STAGE(Stage::Cipher);
+                    slot.checksum = encrypt_padded_checked(cipher, slot.output.data(), &slot.output[0], stream);
+                    stats.record(cipher, slot.output.size() / cipher.segment_bytes, slot.input.size());
+                    return;
+                }
+                XEC_TIME_STAGE(Stage::Cipher);
+                std::size_t segment_count = encrypt_chunk(cipher, slot.input, slot.output, slot.checksum);
+                stats.record(cipher, segment_count, slot.input.size());
+            },
+            [&](ChunkSlot &slot) {
+                if (text_file.is_open()) {
+                    XEC_TIME_STAGE(Stage::TextExport);
+                    write_text_export(text_file, slot.output, text);
+                }
+                {
+                    XEC_TIME_STAGE(Stage::Write);
+#ifdef XEC_HAVE_LIBURING
+                    if (uring_writer) {
+                        // The ring takes slot.output itself, so the payload goes last
+                        uint64_t offset = writer.reserve_chunk(slot.sequence, slot.output.size(), slot.input.size(), slot.checksum);
+                        uring_writer->write(offset, slot.output);
+                    } else
+#endif
+                    writer.write_chunk(slot.sequence, slot.output, slot.input.size(), slot.checksum);
+                }
+                release_budget(chunk_footprint);
+            });
+    } catch (...) {
+        release_budget(budget_held); // chunks abandoned mid-pipeline must not starve other files
+        throw;
+    }
+    if (steady && chunks > 2 * ring.capacity()) {
+        steady->allocations += heap_allocations() - steady_start;
+        steady->chunks += chunks - 2 * ring.capacity();
+    }
+#ifdef XEC_HAVE_LIBURING
+    if (uring_writer) {
+        XEC_TIME_STAGE(Stage::Write);
+        uring_writer->drain();
+    }
+#endif
+    XEC_TIME_STAGE(Stage::Write);
+    writer.finish();
+}
+
+// Function to encrypt through the zero-copy backend: the kernel reads plaintext straight from the
+// mapped input and writes ciphertext into a pre-sized mapping of the container
+inline void encrypt_file_mapped(const KeySchedule &cipher, const std::string &input_filename, const std::string &container_filename,
+                                std::size_t chunk_size, WorkerPool *pool, CipherStats &stats) {
+    MappedFile input = MappedFile::open_read(input_filename);
+
+    std::vector<ChunkEntry> entries;
+    uint64_t index_offset = plan_container_layout(input.size(), chunk_size, cipher.segment_bytes, entries);
+    MappedFile output = MappedFile::create(container_filename, container_file_size(index_offset, entries.size(), true));
+    ContainerHeader header = make_container_header(cipher.width, chunk_size, entries.size(), index_offset, input.size());
+    set_container_key_id(header, cipher.key_id);
+    header.flags |= CONTAINER_FLAG_CRC32C;
+    std::memcpy(output.data(), &header, sizeof(header));
+    if (!entries.empty()) {
+        std::memcpy(output.data() + index_offset, entries.data(), entries.size() * sizeof(ChunkEntry));
+    }
+    // Workers store each chunk's checksum straight into the table that follows the index
+    uint8_t *checksums = output.data() + index_offset + entries.size() * sizeof(ChunkEntry);
+
+    auto encrypt_one = [&](uint64_t index) {
+        XEC_TIME_STAGE(Stage::Cipher);
+        const ChunkEntry &entry = entries[index];
+        uint32_t checksum = encrypt_padded_checked(cipher, input.data() + index * chunk_size, output.data() + entry.offset, entry.plain_size);
+        std::memcpy(checksums + index * sizeof(checksum), &checksum, sizeof(checksum));
+        stats.record(cipher, entry.size / cipher.segment_bytes, entry.plain_size);
+    };
+    detail::run_chunk_tasks(pool, entries.size(), encrypt_one);
+}
+
+// Function to decrypt a container as a reader -> workers -> in-order writer pipeline, with at
+// most `in_flight` chunks resident so memory does not grow with the file size. Returns the number
+// of chunks that failed their checksum (reported on stderr and zero-filled).
+template <typename Cipher>
+std::size_t decrypt_file_in_chunks(const Cipher &cipher, const std::string &container_filename, const std::string &plaintext_filename,
+                                   WorkerPool *pool, std::size_t in_flight, CipherStats &stats, SteadyAllocations *steady = nullptr) {
+    ContainerReader reader(container_filename);
+    if (reader.header().segment_bits != cipher.width) {
+        throw std::runtime_error("Expected " + std::to_string(cipher.width) + "-bit segments, container has " + std::to_string(reader.header().segment_bits));
+    }
+    std::ofstream decrypted_file(plaintext_filename, std::ios::binary);
+    if (!decrypted_file) {
+        throw std::runtime_error("Cannot open encrypted or decrypted file.");
+    }
+
+    const uint64_t chunk_count = reader.chunk_count();
+    // Deflate payloads vary per chunk and incompressible ones outgrow the plain payload, so the
+    // input slots are sized for the largest payload in the index
+    uint64_t max_payload = 0;
+    for (uint64_t index = 0; index < chunk_count; ++index) {
+        max_payload = std::max(max_payload, reader.entry(index).size);
+    }
+    OrderedChunkRing ring(in_flight);
+    place_chunk_slots(ring, pool, max_payload, reader.header().chunk_size);
+    ChunkVerifier verifier(reader.has_checksums(), chunk_count);
+    // Compressed chunks are decrypted into a per-worker buffer and inflated from there
+    std::unique_ptr<ChunkCodecs> codecs(reader.compressed() ? new ChunkCodecs(pool, 0, max_payload) : nullptr);
+    uint64_t steady_start = 0;
+
+    uint64_t chunks = run_chunk_pipeline(ring, pool,
+        [&](ChunkSlot &slot) {
+            if (steady && slot.sequence == 2 * ring.capacity()) {
+                steady_start = heap_allocations();
+            }
+            if (slot.sequence >= chunk_count) {
+                return false;
+            }
+            XEC_TIME_STAGE(Stage::Read);
+            reader.read_chunk(slot.sequence, slot.input);
+            return true;
+        },
+        [&reader, &stats, &verifier, &codecs, &cipher](ChunkSlot &slot) {
+            XEC_TIME_STAGE(Stage::Cipher);
+            uint64_t index = slot.sequence;
+            uint32_t expected = verifier.enabled() ? reader.checksum(index) : 0;
+            if (codecs) {
+                slot.output.resize(reader.entry(index).plain_size);
+                decrypt_decompress(cipher, codecs->local(), reinterpret_cast<const uint8_t *>(slot.input.data()), slot.input.size(),
+                                   reinterpret_cast<uint8_t *>(&slot.output[0]), slot.output.size(), verifier, index, expected);
+            } else {
+                decrypt_chunk(cipher, slot.input, reader.entry(index).plain_size, slot.output, verifier, index, expected);
+            }
+            stats.record(cipher, slot.input.size() / cipher.segment_bytes, slot.output.size());
+        },
+        [&](ChunkSlot &slot) {
+            XEC_TIME_STAGE(Stage::Write);
+            decrypted_file.write(slot.output.data(), slot.output.size());
+            if (!decrypted_file) {
+                throw std::runtime_error("Failed writing decrypted file");
+            }
+        });
+    if (steady && chunks > 2 * ring.capacity()) {
+        steady->allocations += heap_allocations() - steady_start;
+        steady->chunks += chunks - 2 * ring.capacity();
+    }
+    decrypted_file.flush();
+    return verifier.report(std::cerr, container_filename);
+}
+
+// Function to decrypt through the zero-copy backend: workers read ciphertext straight from the
+// mapped container and write into a pre-sized mapping of the output file. Returns the number of
+// chunks that failed their checksum, as decrypt_file_in_chunks() does.
+template <typename Cipher>
+std::size_t decrypt_file_mapped(const Cipher &cipher, const std::string &container_filename, const std::string &plaintext_filename,
+                                WorkerPool *pool, CipherStats &stats) {
+    MappedFile encrypted_file = MappedFile::open_read(container_filename);
+    ContainerView container(encrypted_file.data(), encrypted_file.size(), container_filename);
+    if (container.header().segment_bits != cipher.width) {
+        throw std::runtime_error("Expected " + std::to_string(cipher.width) + "-bit segments, container has " + std::to_string(container.header().segment_bits));
+    }
+
+    // Every chunk's plaintext offset is known up front, so the output is mapped at its final size
+    std::vector<uint64_t> plain_offsets(container.chunk_count() + 1, 0);
+    for (uint64_t index = 0; index < container.chunk_count(); ++index) {
+        plain_offsets[index + 1] = plain_offsets[index] + container.entry(index).plain_size;
+    }
+    MappedFile decrypted_file = MappedFile::create(plaintext_filename, plain_offsets.back());
+
+    ChunkVerifier verifier(container.has_checksums(), container.chunk_count());
+    std::unique_ptr<ChunkCodecs> codecs(container.compressed() ? new ChunkCodecs(pool, 0) : nullptr);
+    auto decrypt_one = [&](uint64_t index) {
+        XEC_TIME_STAGE(Stage::Cipher);
+        const ChunkEntry &entry = container.entry(index);
+        uint8_t *plaintext = decrypted_file.data() + plain_offsets[index];
+        if (codecs) {
+            decrypt_decompress(cipher, codecs->local(), container.chunk_data(index), entry.size, plaintext, entry.plain_size, verifier, index,
+                               verifier.enabled() ? container.checksum(index) : 0);
+        } else if (verifier.enabled()) {
+            verifier.check(index, decrypt_checked(cipher, container.chunk_data(index), plaintext, entry.plain_size, entry.size), container.checksum(index));
+        } else {
+            cipher.decrypt(container.chunk_data(index), plaintext, entry.plain_size);
+        }
+        stats.record(cipher, entry.size / cipher.segment_bytes, entry.plain_size);
+    };
+    detail::run_chunk_tasks(pool, container.chunk_count(), decrypt_one);
+    return verifier.report(std::cerr, container_filename);
+}
+
+} // namespace xec
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "ChunkChecksum.h"
+#include "CipherContainer.h"
+#include "CipherStats.h"
+#include "KeySchedule.h"
+#include "MappedFile.h"
+#include "WorkerPool.h"
+
+// Incremental re-encryption (ParaEn / XecLDS_SDS --incremental).
+//
+// Next to each container, "<container>.manifest" records the plaintext layout it was built
+// from and a 64-bit fingerprint (XXH64) per chunk. A later run fingerprints the input again,
+// which costs a read at memory bandwidth, and encrypts and writes only the chunks whose
+// fingerprint or length changed:
+//   - a changed chunk of unchanged length is re-encrypted into its existing payload;
+//   - new chunks, and a last chunk that grew, are appended where the old index was (a grown
+//     last chunk that was the last payload is rewritten in place of its old payload);
+//   - the index, chunk checksums (unchanged chunks keep theirs) and header are rewritten.
+// So an appended log costs about the appended bytes. A shrunken input, a different chunk size,
+// width or key, a compressed container or one without checksums, or a missing or mismatched
+// manifest rebuilds the container from scratch. The manifest is removed before a container is
+// patched and written back afterwards, so a run that dies half way leaves no manifest and the
+// next run rebuilds.
+namespace xec {
+
+constexpr char MANIFEST_MAGIC[4] = {'X', 'E', 'C', 'M'};
+constexpr uint16_t MANIFEST_VERSION = 1;
+
+struct ManifestHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t segment_bits;
+    uint64_t chunk_size;
+    uint64_t chunk_count;     // fingerprints that follow the header
+    uint64_t plaintext_size;
+    char key_id[16];          // as in ContainerHeader
+};
+static_assert(sizeof(ManifestHeader) == 48, "ManifestHeader must stay 48 bytes");
+
+namespace detail {
+
+constexpr uint64_t XXH_PRIME1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t XXH_PRIME2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t XXH_PRIME3 = 0x165667B19E3779F9ull;
+constexpr uint64_t XXH_PRIME4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t XXH_PRIME5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t rotl64(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+inline uint64_t read64(const uint8_t *p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t read32(const uint8_t *p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    return rotl64(acc + input * XXH_PRIME2, 31) * XXH_PRIME1;
+}
+
+inline uint64_t xxh_merge(uint64_t acc, uint64_t lane) {
+    return (acc ^ xxh_round(0, lane)) * XXH_PRIME1 + XXH_PRIME4;
+}
+
+} // namespace detail
+
+// Function to fingerprint a chunk: XXH64 with seed 0, four independent lanes over 32-byte stripes
+inline uint64_t chunk_fingerprint(const uint8_t *data, std::size_t size) {
+    using namespace detail;
+    const uint8_t *p = data;
+    const uint8_t *end = data + size;
+    uint64_t hash;
+    if (size >= 32) {
+        uint64_t v1 = XXH_PRIME1 + XXH_PRIME2, v2 = XXH_PRIME2, v3 = 0, v4 = 0 - XXH_PRIME1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = xxh_round(v1, read64(p));
+            v2 = xxh_round(v2, read64(p + 8));
+            v3 = xxh_round(v3, read64(p + 16));
+            v4 = xxh_round(v4, read64(p + 24));
+        }
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = xxh_merge(hash, v1);
+        hash = xxh_merge(hash, v2);
+        hash = xxh_merge(hash, v3);
+        hash = xxh_merge(hash, v4);
+    } else {
+        hash = XXH_PRIME5;
+    }
+    hash += size;
+    for (; p + 8 <= end; p += 8) {
+        hash = rotl64(hash ^ xxh_round(0, read64(p)), 27) * XXH_PRIME1 + XXH_PRIME4;
+    }
+    if (p + 4 <= end) {
+        hash = rotl64(hash ^ (read32(p) * XXH_PRIME1), 23) * XXH_PRIME2 + XXH_PRIME3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash = rotl64(hash ^ (*p * XXH_PRIME5), 11) * XXH_PRIME1;
+    }
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+struct ChunkManifest {
+    ManifestHeader header;
+    std::vector<uint64_t> fingerprints;
+
+    // Function to read a manifest; false if it is missing or not one this build wrote
+    static bool load(const std::string &filename, ChunkManifest &manifest) {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in || !in.read(reinterpret_cast<char *>(&manifest.header), sizeof(manifest.header))) {
+            return false;
+        }
+        if (std::memcmp(manifest.header.magic, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC)) != 0 || manifest.header.version != MANIFEST_VERSION) {
+            return false;
+        }
+        manifest.fingerprints.resize(manifest.header.chunk_count);
+        in.read(reinterpret_cast<char *>(manifest.fingerprints.data()), manifest.fingerprints.size() * sizeof(uint64_t));
+        return static_cast<std::size_t>(in.gcount()) == manifest.fingerprints.size() * sizeof(uint64_t);
+    }
+
+    void save(const std::string &filename) const {
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(fingerprints.data()), fingerprints.size() * sizeof(uint64_t));
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("Failed writing manifest: " + filename);
+        }
+    }
+};
+
+// Function to drop the manifest of a container that is about to be rewritten some other way,
+// so a later incremental run cannot trust fingerprints of data the container no longer holds
+inline void discard_manifest(const std::string &container_filename) {
+    std::remove((container_filename + ".manifest").c_str());
+}
+
+// What an incremental run did
+struct IncrementalResult {
+    uint64_t chunks = 0;          // chunks in the input
+    uint64_t changed_chunks = 0;  // chunks encrypted and written this run
+    uint64_t changed_bytes = 0;   // plaintext bytes encrypted and written this run
+    bool rebuilt = false;         // the container was written from scratch
+};
+
+// Function to bring `container_filename` up to date with `input_filename`, encrypting only the
+// chunks that changed since the manifest was written (see the top of this file). Chunks run on
+// `pool`, or on the calling thread if it is null; their segments are counted in `stats`.
+inline IncrementalResult encrypt_incremental(const KeySchedule &cipher, const std::string &input_filename, const std::string &container_filename,
+                                             uint64_t chunk_size, WorkerPool *pool, CipherStats &stats) {
+    const std::string manifest_filename = container_filename + ".manifest";
+    MappedFile input = MappedFile::open_read(input_filename);
+    const uint64_t plaintext_size = input.size();
+
+    IncrementalResult result;
+    result.chunks = (plaintext_size + chunk_size - 1) / chunk_size;
+    ChunkManifest manifest;
+    manifest.header = ManifestHeader{};
+    std::memcpy(manifest.header.magic, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+    manifest.header.version = MANIFEST_VERSION;
+    manifest.header.segment_bits = static_cast<uint16_t>(cipher.width);
+    manifest.header.chunk_size = chunk_size;
+    manifest.header.chunk_count = result.chunks;
+    manifest.header.plaintext_size = plaintext_size;
+    std::memcpy(manifest.header.key_id, cipher.key_id.data(), std::min(cipher.key_id.size(), sizeof(manifest.header.key_id)));
+    manifest.fingerprints.resize(result.chunks);
+    auto plain_size = [&](uint64_t index) { return std::min(chunk_size, plaintext_size - index * chunk_size); };
+    auto fingerprint_one = [&](uint64_t index) {
+        manifest.fingerprints[index] = chunk_fingerprint(input.data() + index * chunk_size, plain_size(index));
+    };
+    detail::run_chunk_tasks(pool, result.chunks, fingerprint_one);
+
+    // The previous run's manifest counts only if it describes the container as it is on disk
+    ChunkManifest previous;
+    ContainerHeader header;
+    std::vector<ChunkEntry> entries;
+    std::vector<uint32_t> checksums;
+    bool patchable = ChunkManifest::load(manifest_filename, previous) &&
+                     std::memcmp(previous.header.key_id, manifest.header.key_id, sizeof(manifest.header.key_id)) == 0 &&
+                     previous.header.segment_bits == cipher.width && previous.header.chunk_size == chunk_size &&
+                     previous.header.plaintext_size <= plaintext_size;
+    if (patchable) {
+        try {
+            ContainerReader reader(container_filename);
+            header = reader.header();
+            patchable = header.chunk_count == previous.header.chunk_count && header.plaintext_size == previous.header.plaintext_size &&
+                        header.segment_bits == cipher.width && header.chunk_size == chunk_size && container_key_id(header) == cipher.key_id &&
+                        reader.has_checksums() && !reader.compressed();
+            for (uint64_t index = 0; patchable && index < reader.chunk_count(); ++index) {
+                entries.push_back(reader.entry(index));
+                checksums.push_back(reader.checksum(index));
+            }
+        } catch (const std::exception &) {
+            patchable = false;
+        }
+    }
+
+    std::vector<uint64_t> changed;
+    uint64_t index_offset = 0;
+    if (patchable) {
+        const uint64_t old_count = entries.size();
+        uint64_t append_at = header.index_offset;
+        entries.resize(result.chunks, ChunkEntry{0, 0, 0});
+        checksums.resize(result.chunks, 0);
+        for (uint64_t index = 0; index < result.chunks; ++index) {
+            uint64_t plain = plain_size(index);
+            bool resized = index >= old_count || entries[index].plain_size != plain;
+            if (!resized && previous.fingerprints[index] == manifest.fingerprints[index]) {
+                continue;
+            }
+            changed.push_back(index);
+            if (resized) {
+                // Only the old last chunk can change length; reuse its payload if nothing follows it
+                if (index < old_count && entries[index].offset + entries[index].size == append_at) {
+                    append_at = entries[index].offset;
+                }
+                entries[index] = ChunkEntry{append_at, cipher.padded_size(plain), plain};
+                append_at += entries[index].size;
+            }
+        }
+        index_offset = append_at;
+        if (changed.empty()) {
+            return result;
+        }
+        discard_manifest(container_filename);
+    } else {
+        discard_manifest(container_filename);
+        index_offset = plan_container_layout(plaintext_size, chunk_size, cipher.segment_bytes, entries);
+        header = make_container_header(static_cast<uint16_t>(cipher.width), chunk_size, 0, 0, 0);
+        set_container_key_id(header, cipher.key_id);
+        checksums.assign(result.chunks, 0);
+        for (uint64_t index = 0; index < result.chunks; ++index) {
+            changed.push_back(index);
+        }
+        result.rebuilt = true;
+    }
+
+    uint64_t container_size = container_file_size(index_offset, entries.size(), true);
+    MappedFile output = patchable ? MappedFile::open_update(container_filename, container_size)
+                                  : MappedFile::create(container_filename, container_size);
+    auto encrypt_one = [&](uint64_t position) {
+        const ChunkEntry &entry = entries[changed[position]];
+        checksums[changed[position]] = encrypt_padded_checked(cipher, input.data() + changed[position] * chunk_size, output.data() + entry.offset, entry.plain_size);
+        stats.record(cipher, entry.size / cipher.segment_bytes, entry.plain_size);
+    };
+    detail::run_chunk_tasks(pool, changed.size(), encrypt_one);
+    for (uint64_t index : changed) {
+        result.changed_bytes += entries[index].plain_size;
+    }
+    result.changed_chunks = changed.size();
+
+    header.chunk_count = entries.size();
+    header.index_offset = index_offset;
+    header.plaintext_size = plaintext_size;
+    header.flags |= CONTAINER_FLAG_CRC32C;
+    if (!entries.empty()) {
+        std::memcpy(output.data() + index_offset, entries.data(), entries.size() * sizeof(ChunkEntry));
+        std::memcpy(output.data() + index_offset + entries.size() * sizeof(ChunkEntry), checksums.data(), checksums.size() * sizeof(uint32_t));
+    }
+    std::memcpy(output.data(), &header, sizeof(header));
+    manifest.save(manifest_filename);
+    return result;
+}
+
+} // namespace xec
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "WorkerPool.h"
+
+// Bounded ring of per-chunk slots for reader -> workers -> in-order writer pipelines.
+//
+// Chunk `sequence` always lives in slot sequence % capacity. The reader blocks in
+// acquire() until the writer has released the chunk `capacity` places earlier, so at
+// most `capacity` chunks (input + output buffers) are ever resident, whatever the file
+// size. Slot buffers keep their capacity between uses and chunk tasks are small enough for
+// std::function's inline storage, so once every slot has been used a run makes no heap
+// allocations per chunk (Bench reports this with -DXEC_COUNT_ALLOCATIONS). The writer
+// consumes slots strictly by sequence number, which makes the output order independent of
+// worker scheduling.
+namespace xec {
+
+struct ChunkSlot {
+    uint64_t sequence = 0;
+    std::string input;
+    std::string output;
+    uint32_t checksum = 0;  // CRC-32C of the ciphertext, set by an encrypting transform
+};
+
+class OrderedChunkRing {
+public:
+    explicit OrderedChunkRing(std::size_t capacity) : slots_(capacity ? capacity : 1), ready_(slots_.size(), false) {}
+
+    std::size_t capacity() const { return slots_.size(); }
+
+    // Reader: wait for the slot of `sequence` to be free and hand it out for filling
+    ChunkSlot &acquire(uint64_t sequence) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [&] { return error_ || sequence < next_write_ + slots_.size(); });
+        rethrow_if_failed();
+        ChunkSlot &slot = slots_[sequence % slots_.size()];
+        slot.sequence = sequence;
+        return slot;
+    }
+
+    // Worker: the slot's output is complete
+    void publish(uint64_t sequence) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            ready_[sequence % slots_.size()] = true;
+        }
+        cv_.notify_all();
+    }
+
+    // Reader: no chunks beyond `total` will be published
+    void close(uint64_t total) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            total_ = total;
+        }
+        cv_.notify_all();
+    }
+
+    // Writer: wait for the next chunk in sequence order; nullptr once every chunk was written
+    ChunkSlot *next_ready() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [&] { return error_ || next_write_ >= total_ || ready_[next_write_ % slots_.size()]; });
+        rethrow_if_failed();
+        if (next_write_ >= total_) {
+            return nullptr;
+        }
+        return &slots_[next_write_ % slots_.size()];
+    }
+
+    // Writer: the chunk returned by next_ready() is on disk; its slot may be reused
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            ready_[next_write_ % slots_.size()] = false;
+            ++next_write_;
+        }
+        cv_.notify_all();
+    }
+
+    // Any stage: abort the pipeline and wake everyone blocked on the ring
+    void fail(std::exception_ptr error) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (!error_) {
+                error_ = error;
+            }
+        }
+        cv_.notify_all();
+    }
+
+    // Slot `index`, for placing its buffers before the ring is used (see place_chunk_slots())
+    ChunkSlot &slot(std::size_t index) { return slots_[index]; }
+
+    // Function to rethrow the first error reported by any stage
+    void check() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        rethrow_if_failed();
+    }
+
+private:
+    void rethrow_if_failed() {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+    std::vector<ChunkSlot> slots_;
+    std::vector<bool> ready_;
+    uint64_t next_write_ = 0;
+    uint64_t total_ = std::numeric_limits<uint64_t>::max();
+    std::exception_ptr error_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+};
+
+// Byte budget shared by pipelines running side by side (e.g. several files on one pool).
+// A reader acquires a chunk's footprint before filling a slot and the writer releases it
+// once the chunk is on disk, so the chunk data in flight across all pipelines stays under
+// the limit. A request larger than the whole limit is granted only when nothing else is
+// held, so an undersized budget degrades to one chunk at a time instead of deadlocking.
+class MemoryBudget {
+public:
+    explicit MemoryBudget(uint64_t limit) : limit_(limit) {}
+
+    uint64_t limit() const { return limit_; }
+
+    void acquire(uint64_t bytes) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [&] { return in_use_ == 0 || in_use_ + bytes <= limit_; });
+        in_use_ += bytes;
+    }
+
+    void release(uint64_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            in_use_ -= bytes;
+        }
+        cv_.notify_all();
+    }
+
+private:
+    uint64_t limit_;
+    uint64_t in_use_ = 0;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+};
+
+// NUMA node whose workers transform chunk `sequence`. It depends only on the chunk's slot, so a
+// slot's buffers are always written by the same node's workers.
+inline std::size_t chunk_node(const OrderedChunkRing &ring, const WorkerPool &pool, uint64_t sequence) {
+    return static_cast<std::size_t>(sequence % ring.capacity()) % pool.node_count();
+}
+
+// Function to allocate every slot's buffers (`input_bytes` and `output_bytes`, the largest chunk
+// either side will hold) from a worker of the slot's node; writing them there first places their
+// pages on that node, and later chunks reuse the capacity. Without a pool, or on a single-node
+// one, they are allocated on the calling thread. Run before the ring's first pipeline.
+inline void place_chunk_slots(OrderedChunkRing &ring, WorkerPool *pool, std::size_t input_bytes, std::size_t output_bytes) {
+    if (!pool || pool->node_count() < 2) {
+        for (std::size_t index = 0; index < ring.capacity(); ++index) {
+            ring.slot(index).input.resize(input_bytes);
+            ring.slot(index).output.resize(output_bytes);
+        }
+        return;
+    }
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::size_t remaining = ring.capacity();
+    for (std::size_t index = 0; index < ring.capacity(); ++index) {
+        ChunkSlot *slot = &ring.slot(index);
+        pool->submit_to_node(chunk_node(ring, *pool, index), [&, slot]() {
+            slot->input.resize(input_bytes);
+            slot->output.resize(output_bytes);
+            std::lock_guard<std::mutex> lock(mtx);
+            if (--remaining == 0) {
+                cv.notify_all();
+            }
+        });
+    }
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&] { return remaining == 0; });
+}
+
+// Function to run read -> transform -> in-order write over a ring and return the chunk count.
+//   read(slot)      fills slot.input, returns false at end of input; runs on the calling thread
+//   transform(slot) fills slot.output; runs on `pool`, or inline on the calling thread if null
+//   write(slot)     consumes slot.output in sequence order; runs on a dedicated writer thread
+// The reader stalls whenever `ring.capacity()` chunks are in flight, which is the
+// backpressure that keeps memory bounded when the writer is the slowest stage. Only this
+// pipeline's own tasks are waited for, so several pipelines can share one pool. On a pool with
+// several nodes each chunk is transformed on its slot's node (see chunk_node()).
+template <typename Read, typename Transform, typename Write>
+uint64_t run_chunk_pipeline(OrderedChunkRing &ring, WorkerPool *pool, Read read, Transform transform, Write write) {
+    std::thread writer([&ring, &write]() {
+        try {
+            while (ChunkSlot *slot = ring.next_ready()) {
+                write(*slot);
+                ring.release();
+            }
+        } catch (...) {
+            ring.fail(std::current_exception());
+        }
+    });
+
+    // Shared by this pipeline's chunk tasks, which capture only a pointer to it and their slot
+    struct TaskState {
+        OrderedChunkRing *ring;
+        Transform *transform;
+        std::mutex mtx;
+        std::condition_variable cv;
+        uint64_t running = 0;
+    } tasks{&ring, &transform, {}, {}, 0};
+
+    uint64_t sequence = 0;
+    try {
+        for (;; ++sequence) {
+            ChunkSlot &slot = ring.acquire(sequence);
+            if (!read(slot)) {
+                break;
+            }
+            auto task = [state = &tasks, chunk = &slot]() {
+                try {
+                    (*state->transform)(*chunk);
+                    state->ring->publish(chunk->sequence);
+                } catch (...) {
+                    state->ring->fail(std::current_exception());
+                }
+                std::lock_guard<std::mutex> lock(state->mtx);
+                --state->running;
+                state->cv.notify_all();
+            };
+            {
+                std::lock_guard<std::mutex> lock(tasks.mtx);
+                ++tasks.running;
+            }
+            if (pool) {
+                pool->submit_to_node(chunk_node(ring, *pool, sequence), task);
+            } else {
+                task();
+            }
+        }
+        ring.close(sequence);
+    } catch (...) {
+        ring.fail(std::current_exception());
+    }
+
+    writer.join();
+    {
+        std::unique_lock<std::mutex> lock(tasks.mtx);
+        tasks.cv.wait(lock, [&] { return tasks.running == 0; });
+    }
+    ring.check();
+    return sequence;
+}
+
+} // namespace xec
@@ -0,0 +1,394 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Packed binary ciphertext container shared by the encryptors and decryptors.
+//
+// Layout (all integers little-endian, as written by the x86-64 hosts we run on):
+//   ContainerHeader   64 bytes at offset 0
+//   chunk payloads    raw ciphertext bytes, one run per chunk
+//   chunk index       chunk_count ChunkEntry records at header.index_offset
+//   chunk checksums   chunk_count uint32 CRC-32Cs of the payloads, right after the index, if
+//                     header.flags has CONTAINER_FLAG_CRC32C (see ChunkChecksum.h)
+//
+// With CONTAINER_FLAG_DEFLATE each chunk's plaintext was deflated on its own before encryption
+// (see ChunkCompression.h): the payload is the padded ciphertext of the deflate stream and the
+// entry's plain_size is still the chunk's uncompressed length.
+//
+// The index is written last so a writer can stream chunks without knowing the
+// final chunk count up front; the header is patched once the index is on disk.
+//
+// Each payload is a whole number of segments: a chunk's last segment is zero-padded before
+// encryption and its entry records the real plaintext length, so decryption restores the
+// original bytes exactly (version 1 dropped any tail shorter than a segment).
+namespace xec {
+
+constexpr char CONTAINER_MAGIC[4] = {'X', 'E', 'C', 'C'};
+constexpr uint16_t CONTAINER_VERSION = 2;
+
+// ContainerHeader::flags; readers that predate a flag still read the container, ignoring it
+constexpr uint32_t CONTAINER_FLAG_CRC32C = 1u;
+constexpr uint32_t CONTAINER_FLAG_DEFLATE = 2u;
+
+struct ContainerHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t segment_bits;   // cipher segment width (128 or 256)
+    uint64_t chunk_size;     // plaintext bytes per chunk (last chunk may be shorter)
+    uint64_t chunk_count;
+    uint64_t index_offset;   // byte offset of the chunk index
+    uint64_t plaintext_size; // total plaintext bytes, i.e. the sum of every chunk's plain_size
+    char key_id[16];         // key file ID of the key used, NUL-padded; all zero for the built-in key
+    uint32_t flags;          // CONTAINER_FLAG_* bits
+    uint8_t reserved[4];
+};
+static_assert(sizeof(ContainerHeader) == 64, "ContainerHeader must stay 64 bytes");
+
+struct ChunkEntry {
+    uint64_t offset;         // byte offset of the chunk payload
+    uint64_t size;           // payload size in bytes (whole segments)
+    uint64_t plain_size;     // plaintext bytes the payload decrypts to (<= size)
+};
+static_assert(sizeof(ChunkEntry) == 24, "ChunkEntry must stay 24 bytes");
+
+// Function to fill in a header; chunk_count/index_offset/plaintext_size may be patched later
+inline ContainerHeader make_container_header(uint16_t segment_bits, uint64_t chunk_size, uint64_t chunk_count, uint64_t index_offset,
+                                             uint64_t plaintext_size) {
+    ContainerHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+    header.version = CONTAINER_VERSION;
+    header.segment_bits = segment_bits;
+    header.chunk_size = chunk_size;
+    header.chunk_count = chunk_count;
+    header.index_offset = index_offset;
+    header.plaintext_size = plaintext_size;
+    return header;
+}
+
+// Function to record which key file key encrypted the container (empty = the built-in key)
+inline void set_container_key_id(ContainerHeader &header, const std::string &key_id) {
+    if (key_id.size() > sizeof(header.key_id)) {
+        throw std::runtime_error("Key ID too long for the container header: " + key_id);
+    }
+    std::memset(header.key_id, 0, sizeof(header.key_id));
+    std::memcpy(header.key_id, key_id.data(), key_id.size());
+}
+
+inline std::string container_key_id(const ContainerHeader &header) {
+    return std::string(header.key_id, strnlen(header.key_id, sizeof(header.key_id)));
+}
+
+// Function to reject anything that is not a container this build can read
+inline void validate_container_header(const ContainerHeader &header, uint64_t file_size, const std::string &filename) {
+    if (std::memcmp(header.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) != 0) {
+        throw std::runtime_error("Not a ciphertext container: " + filename);
+    }
+    if (header.version != CONTAINER_VERSION) {
+        throw std::runtime_error("Unsupported container version " + std::to_string(header.version));
+    }
+    if (header.chunk_size == 0) {
+        throw std::runtime_error("Zero chunk size in " + filename);
+    }
+    if (header.index_offset > file_size || header.chunk_count > (file_size - header.index_offset) / sizeof(ChunkEntry)) {
+        throw std::runtime_error("Truncated chunk index in " + filename);
+    }
+    if ((header.flags & CONTAINER_FLAG_CRC32C) &&
+        header.chunk_count * sizeof(uint32_t) > file_size - header.index_offset - header.chunk_count * sizeof(ChunkEntry)) {
+        throw std::runtime_error("Truncated chunk checksums in " + filename);
+    }
+}
+
+// Function to return the size of a container whose payloads end at `index_offset`
+inline uint64_t container_file_size(uint64_t index_offset, uint64_t chunk_count, bool checksums) {
+    return index_offset + chunk_count * (sizeof(ChunkEntry) + (checksums ? sizeof(uint32_t) : 0));
+}
+
+// Function to reject an index entry whose plaintext length does not fit its payload (or, for a
+// compressed chunk, its chunk)
+inline void validate_chunk_entry(const ContainerHeader &header, const ChunkEntry &entry, uint64_t index, const std::string &filename) {
+    bool compressed = (header.flags & CONTAINER_FLAG_DEFLATE) != 0;
+    if (entry.plain_size > (compressed ? header.chunk_size : entry.size)) {
+        throw std::runtime_error("Chunk " + std::to_string(index) + " has a bad plaintext length in " + filename);
+    }
+}
+
+// Function to lay out a container whose chunk payload sizes are known up front (used by the
+// mapped writer); fills `entries` and returns the index offset, i.e. the end of the payloads.
+// Each chunk's payload is its plaintext rounded up to whole segments, matching the streaming encryptors.
+inline uint64_t plan_container_layout(uint64_t plaintext_size, uint64_t chunk_size, uint64_t segment_bytes, std::vector<ChunkEntry> &entries) {
+    uint64_t chunk_count = (plaintext_size + chunk_size - 1) / chunk_size;
+    entries.resize(chunk_count);
+    uint64_t payload_end = sizeof(ContainerHeader);
+    for (uint64_t i = 0; i < chunk_count; ++i) {
+        uint64_t plain = std::min(chunk_size, plaintext_size - i * chunk_size);
+        entries[i] = ChunkEntry{payload_end, (plain + segment_bytes - 1) / segment_bytes * segment_bytes, plain};
+        payload_end += entries[i].size;
+    }
+    return payload_end;
+}
+
+// Function to write a container: chunks may arrive in any order, each is appended
+// to the payload area and its index entry recorded
+class ContainerWriter {
+public:
+    ContainerWriter(const std::string &filename, uint16_t segment_bits, uint64_t chunk_size)
+        : out_(filename, std::ios::binary | std::ios::trunc) {
+        if (!out_) {
+            throw std::runtime_error("Cannot open output file: " + filename);
+        }
+        header_ = make_container_header(segment_bits, chunk_size, 0, 0, 0);
+        out_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+        payload_end_ = sizeof(header_);
+    }
+
+    // Function to record the key file ID of the key the chunks are encrypted with
+    void set_key_id(const std::string &key_id) {
+        set_container_key_id(header_, key_id);
+    }
+
+    // Function to store a CRC-32C per chunk; every chunk must then be given its payload's checksum
+    void enable_checksums() {
+        header_.flags |= CONTAINER_FLAG_CRC32C;
+    }
+
+    // Function to mark the payloads as encrypted deflate streams; `plain_size` stays the uncompressed length
+    void enable_compression() {
+        header_.flags |= CONTAINER_FLAG_DEFLATE;
+    }
+
+    // Function to size the chunk index up front, so recording chunks never reallocates it
+    void reserve_index(uint64_t chunk_count) {
+        entries_.reserve(chunk_count);
+        checksums_.reserve(chunk_count);
+    }
+
+    // `size` padded ciphertext bytes that decrypt to `plain_size` plaintext bytes
+    void write_chunk(uint64_t index, const char *data, std::size_t size, uint64_t plain_size, uint32_t checksum = 0) {
+        reserve_chunk(index, size, plain_size, checksum);
+        out_.write(data, size);
+    }
+
+    void write_chunk(uint64_t index, const std::string &data, uint64_t plain_size, uint32_t checksum = 0) {
+        write_chunk(index, data.data(), data.size(), plain_size, checksum);
+    }
+
+    // Function to record a chunk whose payload the caller writes itself (e.g. with asynchronous
+    // I/O); returns the file offset the `size` payload bytes must be written at
+    uint64_t reserve_chunk(uint64_t index, std::size_t size, uint64_t plain_size, uint32_t checksum = 0) {
+        if (index >= entries_.size()) {
+            entries_.resize(index + 1, ChunkEntry{0, 0, 0});
+            checksums_.resize(index + 1, 0);
+        }
+        entries_[index] = ChunkEntry{payload_end_, size, plain_size};
+        checksums_[index] = checksum;
+        payload_end_ += size;
+        header_.plaintext_size += plain_size;
+        return entries_[index].offset;
+    }
+
+    // Function to write the chunk index and patch the header; must be called once
+    void finish() {
+        header_.chunk_count = entries_.size();
+        header_.index_offset = payload_end_;
+        out_.seekp(payload_end_);
+        out_.write(reinterpret_cast<const char *>(entries_.data()), entries_.size() * sizeof(ChunkEntry));
+        if (header_.flags & CONTAINER_FLAG_CRC32C) {
+            out_.write(reinterpret_cast<const char *>(checksums_.data()), checksums_.size() * sizeof(uint32_t));
+        }
+        out_.seekp(0);
+        out_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+        out_.flush();
+        if (!out_) {
+            throw std::runtime_error("Failed writing ciphertext container");
+        }
+    }
+
+private:
+    std::ofstream out_;
+    ContainerHeader header_;
+    std::vector<ChunkEntry> entries_;
+    std::vector<uint32_t> checksums_;
+    uint64_t payload_end_ = 0;
+};
+
+// Function to open a container, validate its header and load the chunk index
+class ContainerReader {
+public:
+    explicit ContainerReader(const std::string &filename) : in_(filename, std::ios::binary) {
+        if (!in_) {
+            throw std::runtime_error("Cannot open encrypted file: " + filename);
+        }
+        in_.seekg(0, std::ios::end);
+        uint64_t file_size = static_cast<uint64_t>(in_.tellg());
+        in_.seekg(0);
+        in_.read(reinterpret_cast<char *>(&header_), sizeof(header_));
+        if (in_.gcount() != sizeof(header_)) {
+            throw std::runtime_error("Not a ciphertext container: " + filename);
+        }
+        validate_container_header(header_, file_size, filename);
+        entries_.resize(header_.chunk_count);
+        in_.seekg(header_.index_offset);
+        in_.read(reinterpret_cast<char *>(entries_.data()), entries_.size() * sizeof(ChunkEntry));
+        if (static_cast<std::size_t>(in_.gcount()) != entries_.size() * sizeof(ChunkEntry)) {
+            throw std::runtime_error("Truncated chunk index in " + filename);
+        }
+        for (uint64_t i = 0; i < header_.chunk_count; ++i) {
+            if (entries_[i].offset > file_size || entries_[i].size > file_size - entries_[i].offset) {
+                throw std::runtime_error("Chunk " + std::to_string(i) + " lies outside " + filename);
+            }
+            validate_chunk_entry(header_, entries_[i], i, filename);
+        }
+        if (has_checksums()) {
+            checksums_.resize(header_.chunk_count);
+            in_.read(reinterpret_cast<char *>(checksums_.data()), checksums_.size() * sizeof(uint32_t));
+            if (static_cast<std::size_t>(in_.gcount()) != checksums_.size() * sizeof(uint32_t)) {
+                throw std::runtime_error("Truncated chunk checksums in " + filename);
+            }
+        }
+    }
+
+    const ContainerHeader &header() const { return header_; }
+    uint64_t chunk_count() const { return header_.chunk_count; }
+    const ChunkEntry &entry(uint64_t index) const { return entries_[index]; }
+    bool has_checksums() const { return (header_.flags & CONTAINER_FLAG_CRC32C) != 0; }
+    uint32_t checksum(uint64_t index) const { return checksums_[index]; }
+    bool compressed() const { return (header_.flags & CONTAINER_FLAG_DEFLATE) != 0; }
+
+    void read_chunk(uint64_t index, std::string &data) {
+        read_payload(index, 0, entries_[index].size, data);
+    }
+
+    // Function to read `size` payload bytes of chunk `index` starting `begin` bytes into the chunk
+    void read_payload(uint64_t index, uint64_t begin, uint64_t size, std::string &data) {
+        const ChunkEntry &e = entries_[index];
+        if (begin > e.size || size > e.size - begin) {
+            throw std::runtime_error("Read past the end of chunk " + std::to_string(index));
+        }
+        data.resize(size);
+        in_.clear();
+        in_.seekg(e.offset + begin);
+        in_.read(&data[0], size);
+        if (static_cast<uint64_t>(in_.gcount()) != size) {
+            throw std::runtime_error("Truncated chunk " + std::to_string(index));
+        }
+    }
+
+private:
+    std::ifstream in_;
+    ContainerHeader header_;
+    std::vector<ChunkEntry> entries_;
+    std::vector<uint32_t> checksums_;
+};
+
+// Function to decrypt plaintext bytes [offset, offset + length) into `plaintext`, reading only the
+// segments that cover the range. Every chunk but the last holds exactly chunk_size plaintext bytes
+// and padding only follows a chunk's last segment, so a plaintext offset maps to its chunk and
+// payload position arithmetically: a point read costs one seek, whatever the file size.
+// Compressed containers are read with decrypt_compressed_range() (ChunkCompression.h).
+template <typename Cipher>
+void decrypt_range(ContainerReader &reader, uint64_t offset, uint64_t length, std::string &plaintext, const Cipher &cipher = Cipher()) {
+    const ContainerHeader &header = reader.header();
+    if (header.segment_bits != cipher.width) {
+        throw std::runtime_error("Expected " + std::to_string(cipher.width) + "-bit segments, container has " + std::to_string(header.segment_bits));
+    }
+    if (reader.compressed()) {
+        throw std::runtime_error("Compressed containers have no per-segment plaintext offsets");
+    }
+    if (offset > header.plaintext_size || length > header.plaintext_size - offset) {
+        throw std::runtime_error("Range " + std::to_string(offset) + "+" + std::to_string(length) +
+                                 " is outside the " + std::to_string(header.plaintext_size) + "-byte plaintext");
+    }
+    plaintext.resize(length);
+    std::string segments;
+    for (uint64_t done = 0; done < length;) {
+        uint64_t index = (offset + done) / header.chunk_size;
+        uint64_t in_chunk = (offset + done) % header.chunk_size;
+        if (index >= reader.chunk_count() || in_chunk >= reader.entry(index).plain_size) {
+            throw std::runtime_error("Chunk index does not cover plaintext offset " + std::to_string(offset + done));
+        }
+        uint64_t take = std::min(length - done, reader.entry(index).plain_size - in_chunk);
+        uint64_t first = in_chunk / cipher.segment_bytes * cipher.segment_bytes;
+        reader.read_payload(index, first, in_chunk + take - first, segments);
+        cipher.decrypt(segments.data(), &segments[0], segments.size());
+        std::memcpy(&plaintext[done], segments.data() + (in_chunk - first), take);
+        done += take;
+    }
+}
+
+// Read-only view of a container that is already in memory (e.g. a mapped file)
+class ContainerView {
+public:
+    ContainerView(const uint8_t *data, std::size_t size, const std::string &filename) : data_(data) {
+        if (size < sizeof(ContainerHeader)) {
+            throw std::runtime_error("Not a ciphertext container: " + filename);
+        }
+        std::memcpy(&header_, data, sizeof(header_));
+        validate_container_header(header_, size, filename);
+        if (header_.chunk_count == 0) {
+            return;
+        }
+        entries_.resize(header_.chunk_count);
+        std::memcpy(entries_.data(), data + header_.index_offset, entries_.size() * sizeof(ChunkEntry));
+        for (uint64_t i = 0; i < header_.chunk_count; ++i) {
+            if (entries_[i].offset > size || entries_[i].size > size - entries_[i].offset) {
+                throw std::runtime_error("Chunk " + std::to_string(i) + " lies outside " + filename);
+            }
+            validate_chunk_entry(header_, entries_[i], i, filename);
+        }
+        if (has_checksums()) {
+            checksums_.resize(header_.chunk_count);
+            std::memcpy(checksums_.data(), data + header_.index_offset + entries_.size() * sizeof(ChunkEntry), checksums_.size() * sizeof(uint32_t));
+        }
+    }
+
+    const ContainerHeader &header() const { return header_; }
+    uint64_t chunk_count() const { return header_.chunk_count; }
+    const ChunkEntry &entry(uint64_t index) const { return entries_[index]; }
+    const uint8_t *chunk_data(uint64_t index) const { return data_ + entries_[index].offset; }
+    bool has_checksums() const { return (header_.flags & CONTAINER_FLAG_CRC32C) != 0; }
+    uint32_t checksum(uint64_t index) const { return checksums_[index]; }
+    bool compressed() const { return (header_.flags & CONTAINER_FLAG_DEFLATE) != 0; }
+
+private:
+    const uint8_t *data_;
+    ContainerHeader header_;
+    std::vector<ChunkEntry> entries_;
+    std::vector<uint32_t> checksums_;
+};
+
+// Function to expand packed bytes to the legacy '0'/'1' text form, MSB first, into `text`
+// (which must have room for size * 8 characters)
+inline void write_bits_as_text(const char *bytes, std::size_t size, char *text) {
+    static const std::array<std::array<char, 8>, 256> table = [] {
+        std::array<std::array<char, 8>, 256> t{};
+        for (int value = 0; value < 256; ++value) {
+            for (int bit = 0; bit < 8; ++bit) {
+                t[value][bit] = ((value >> (7 - bit)) & 1) ? '1' : '0';
+            }
+        }
+        return t;
+    }();
+    for (std::size_t i = 0; i < size; ++i) {
+        std::memcpy(text + i * 8, table[static_cast<unsigned char>(bytes[i])].data(), 8);
+    }
+}
+
+inline void append_bits_as_text(const char *bytes, std::size_t size, std::string &text) {
+    std::size_t pos = text.size();
+    text.resize(pos + size * 8);
+    write_bits_as_text(bytes, size, &text[pos]);
+}
+
+inline void append_bits_as_text(const std::string &bytes, std::string &text) {
+    append_bits_as_text(bytes.data(), bytes.size(), text);
+}
+
+} // namespace xec
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "WorkerPool.h"
+
+// Per-run cipher statistics shared by the encryptors and decryptors.
+//
+// Each pool worker, plus the thread that owns the stats, counts into its own cache-line-sized
+// slot, so recording a chunk is a few plain adds on a line no other core writes. The slots
+// are summed once, by totals(), after the run's tasks have been joined.
+namespace xec {
+
+struct CipherTotals {
+    uint64_t segments = 0;      // whole segments run through the cipher (padding included)
+    uint64_t flipped_bits = 0;  // bits that differ between cipher input and output (the mask's set bits per segment)
+    uint64_t bits = 0;          // segments * segment width
+    uint64_t bytes = 0;         // plaintext bytes encrypted or produced
+
+    // Average Avalanche Effect in percent: a constant of the key (its mask's set bits per segment);
+    // for how input bit flips spread through the ciphertext, see DiffusionAnalysis.h
+    double avalanche_effect() const { return bits ? (static_cast<double>(flipped_bits) / bits) * 100.0 : 0.0; }
+};
+
+class CipherStats {
+public:
+    // One slot per worker of `pool` plus one for the owning thread; null means single-threaded
+    explicit CipherStats(const WorkerPool *pool = nullptr) : pool_(pool), slots_(pool ? pool->size() + 1 : 1) {}
+
+    CipherStats(const CipherStats &) = delete;
+    CipherStats &operator=(const CipherStats &) = delete;
+
+    // Function to count `segments` segments of `Cipher` covering `bytes` plaintext bytes; call
+    // only from a worker of the pool or from the thread that owns the stats
+    template <typename Cipher>
+    void record(uint64_t segments, uint64_t bytes) {
+        record(Cipher(), segments, bytes);
+    }
+
+    // Same, for a cipher object such as a runtime KeySchedule
+    template <typename Cipher>
+    void record(const Cipher &cipher, uint64_t segments, uint64_t bytes) {
+        CipherTotals &slot = slots_[pool_ ? pool_->current_worker() : 0].totals;
+        slot.segments += segments;
+        slot.flipped_bits += segments * cipher.flipped_bits;
+        slot.bits += segments * cipher.width;
+        slot.bytes += bytes;
+    }
+
+    // Function to sum every slot; the recording tasks must have finished
+    CipherTotals totals() const {
+        CipherTotals sum;
+        for (const Slot &slot : slots_) {
+            sum.segments += slot.totals.segments;
+            sum.flipped_bits += slot.totals.flipped_bits;
+            sum.bits += slot.totals.bits;
+            sum.bytes += slot.totals.bytes;
+        }
+        return sum;
+    }
+
+    // Function to sum the slots of each node's workers (the owning thread's slot counts toward
+    // node 0); one entry per node of the pool, a single entry without a pool
+    std::vector<CipherTotals> node_totals() const {
+        std::vector<CipherTotals> nodes(pool_ ? pool_->node_count() : 1);
+        for (std::size_t index = 0; index < slots_.size(); ++index) {
+            const CipherTotals &slot = slots_[index].totals;
+            CipherTotals &sum = nodes[pool_ && index < pool_->size() ? pool_->worker_node(index) : 0];
+            sum.segments += slot.segments;
+            sum.flipped_bits += slot.flipped_bits;
+            sum.bits += slot.bits;
+            sum.bytes += slot.bytes;
+        }
+        return nodes;
+    }
+
+private:
+    struct alignas(64) Slot {
+        CipherTotals totals;
+    };
+
+    const WorkerPool *pool_;
+    std::vector<Slot> slots_;
+};
+
+} // namespace xec
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <sched.h>
+#include <pthread.h>
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// NUMA layout of the CPUs this process may run on, for pinning WorkerPool threads.
+//
+// Nodes come from /sys/devices/system/node/node<N>/cpulist, restricted to the process's
+// affinity mask (so taskset/cgroup limits are honoured); nodes with no usable CPU are dropped.
+// Without the sysfs node directory (non-NUMA kernels) every usable CPU is one node. Memory is
+// placed by first touch: a page lands on the node of the thread that first writes it, so a
+// buffer first written by a pinned worker is local to that worker's node. No libnuma needed.
+namespace xec {
+
+// Function to parse a kernel CPU list such as "0-3,8,10-11"
+inline std::vector<int> parse_cpu_list(const std::string &text) {
+    std::vector<int> cpus;
+    for (std::size_t start = 0; start < text.size();) {
+        std::size_t end = text.find(',', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string range = text.substr(start, end - start);
+        std::size_t dash = range.find('-');
+        if (!range.empty() && range.find_first_not_of("0123456789-\n") == std::string::npos) {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        start = end + 1;
+    }
+    return cpus;
+}
+
+struct CpuTopology {
+    std::vector<std::vector<int>> node_cpus; // usable CPUs of each node, never empty
+
+    std::size_t node_count() const { return node_cpus.size(); }
+
+    std::size_t cpu_count() const {
+        std::size_t count = 0;
+        for (const auto &cpus : node_cpus) {
+            count += cpus.size();
+        }
+        return count;
+    }
+
+    // Function to read the topology of the running machine
+    static CpuTopology detect() {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            throw std::runtime_error("Cannot read the CPU affinity mask");
+        }
+
+        CpuTopology topology;
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string nodes;
+        if (online && std::getline(online, nodes)) {
+            for (int node : parse_cpu_list(nodes)) {
+                std::ifstream list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                std::string text;
+                std::getline(list, text);
+                std::vector<int> cpus;
+                for (int cpu : parse_cpu_list(text)) {
+                    if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+                if (!cpus.empty()) {
+                    topology.node_cpus.push_back(cpus);
+                }
+            }
+        }
+        if (topology.node_cpus.empty()) {
+            std::vector<int> cpus;
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &allowed)) {
+                    cpus.push_back(cpu);
+                }
+            }
+            topology.node_cpus.push_back(cpus);
+        }
+        return topology;
+    }
+};
+
+// Function to bind `thread` to one CPU
+inline void pin_thread(pthread_t thread, int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int error = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (error != 0) {
+        throw std::runtime_error("Cannot pin thread to CPU " + std::to_string(cpu));
+    }
+}
+
+} // namespace xec
@@ -0,0 +1,705 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <unistd.h>
+#include "CipherContainer.h"
+#include "ChunkChecksum.h"
+#include "ChunkCompression.h"
+#include "SegmentCipher.h"
+#include "KeySchedule.h"
+#include "UringIO.h"
+#include "XecLib.h"
+
+// Differential correctness harness for the cipher engines and their fast paths.
+//
+// Every check compares against a deliberately naive reference model: the original text pipeline
+// (bytes -> '0'/'1' string -> segments, XOR with the bitset of the key string, flip the mutation
+// positions), with the last segment of each chunk zero-padded, and a bitwise CRC-32C. It shares
+// no code with SegmentKernel.h or ChunkChecksum.h, so a kernel, chunking or threading change that
+// alters a single output bit fails here.
+//
+//   kernels  every XOR kernel the CPU has (scalar/AVX2/AVX-512) at unaligned addresses, the
+//            compile-time and key file ciphers, encrypt_padded_checked()/decrypt_checked() and
+//            their CRCs, on random sizes that are not whole segments
+//   library  XecLib.h encrypt()/decrypt() and encrypt_batch()/decrypt_batch(), inline and on a
+//            pool, on 64 B - 16 KB messages at unaligned addresses, against Cipher::encrypt()
+//   ranges   containers written with random chunk sizes, read back whole and with
+//            decrypt_range() / decrypt_compressed_range() over random ranges
+//   engines  (with --bin-dir) ParaEn and XecLDS_SDS across chunk sizes, thread counts, in-flight
+//            depths, I/O backends and a key file key, byte for byte against reference
+//            containers; ParaDec and XEC_Dec_LDS must then restore the plaintext, whole and by range
+//   parsers  corrupted and truncated containers through fuzz_container(), the parse-and-decrypt
+//            path the fuzzer drives; malformed input must fail with an exception, nothing worse
+//   uring    (built with -DXEC_HAVE_LIBURING -luring) UringChunkReader/UringChunkWriter at random
+//            chunk sizes and depths, handing chunks over by swapping strings as the pipelines
+//            do; engine runs with --io uring only reach io_uring if the binaries were built the
+//            same way, and the summary counts the runs that fell back to streams
+//
+// Case N runs with seed --seed + N, so a failure names the seed that replays it alone. The
+// checksum and CRC kernels are picked once per process: rerun with XEC_KERNEL=scalar (and avx2)
+// to cover the fallbacks. Build with -DXEC_FUZZ -fsanitize=fuzzer,address for a libFuzzer
+// target of fuzz_container() instead of the harness.
+//
+// Usage: DiffCheck [--cases N] [--seed N] [--max-size BYTES] [--bin-dir DIR] [--work-dir diffcheck]
+
+namespace {
+
+// A key as the original pipeline held it: the key string and the mutation positions
+struct ReferenceKey {
+    std::size_t width;
+    std::string bits;
+    std::vector<std::size_t> mutations;
+};
+
+const ReferenceKey REFERENCE_256{256, xec::XecKey256::bits, {50, 100, 150}};
+const ReferenceKey REFERENCE_128{128, xec::XecKey128::bits, {50}};
+
+// Function to encrypt one chunk as the original bitset pipeline did, zero-padded to whole segments
+std::string reference_encrypt(const ReferenceKey &key, const std::string &chunk) {
+    std::string text;
+    for (char ch : chunk) {
+        for (int bit = 7; bit >= 0; --bit) {
+            text += ((static_cast<unsigned char>(ch) >> bit) & 1) ? '1' : '0';
+        }
+    }
+    text.resize((text.size() + key.width - 1) / key.width * key.width, '0');
+    // std::bitset<width>(key.bits) keeps the first `width` characters, the last of them as bit 0;
+    // character i of a segment's text is bit (width - 1 - i)
+    std::string mask(key.width, '0');
+    std::size_t length = std::min(key.bits.size(), key.width);
+    for (std::size_t bit = 0; bit < length; ++bit) {
+        mask[key.width - 1 - bit] = key.bits[length - 1 - bit];
+    }
+    for (std::size_t position : key.mutations) {
+        char &c = mask[key.width - 1 - position];
+        c = c == '0' ? '1' : '0';
+    }
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (mask[i % key.width] == '1') {
+            text[i] = text[i] == '0' ? '1' : '0';
+        }
+    }
+    std::string bytes(text.size() / 8, '\0');
+    for (std::size_t i = 0; i < bytes.size(); ++i) {
+        unsigned value = 0;
+        for (std::size_t bit = 0; bit < 8; ++bit) {
+            value = value << 1 | (text[i * 8 + bit] == '1');
+        }
+        bytes[i] = static_cast<char>(value);
+    }
+    return bytes;
+}
+
+// Function to compute a CRC-32C one bit at a time
+uint32_t reference_crc32c(const std::string &data) {
+    uint32_t crc = ~0u;
+    for (char ch : data) {
+        crc ^= static_cast<unsigned char>(ch);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+std::string random_bytes(std::mt19937_64 &rng, std::size_t size) {
+    std::string bytes(size, '\0');
+    // Mostly random bytes, sometimes runs of text so compression has something to do
+    bool text = rng() % 2 == 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        bytes[i] = text ? "abc de\n"[rng() % 7] : static_cast<char>(rng());
+    }
+    return bytes;
+}
+
+// Function to draw a size, favouring the edges: empty, below one segment, around segment and
+// block multiples, and anything up to `max_size`
+std::size_t random_size(std::mt19937_64 &rng, std::size_t max_size) {
+    switch (rng() % 4) {
+        case 0: return rng() % 80;
+        case 1: return std::min<std::size_t>(max_size, (rng() % 200 + 1) * 64 + rng() % 3 - 1);
+        default: return rng() % (max_size + 1);
+    }
+}
+
+ReferenceKey random_key(std::mt19937_64 &rng, std::size_t width) {
+    ReferenceKey key{width, std::string(rng() % (width + 40) + 1, '0'), {}};
+    for (char &c : key.bits) {
+        c = rng() % 2 ? '1' : '0';
+    }
+    for (std::size_t count = rng() % 6; count > 0; --count) {
+        key.mutations.push_back(rng() % width);
+    }
+    return key;
+}
+
+std::string join_positions(const std::vector<std::size_t> &positions) {
+    std::string text;
+    for (std::size_t position : positions) {
+        text += (text.empty() ? "" : ",") + std::to_string(position);
+    }
+    return text;
+}
+
+void expect(bool ok, const std::string &what) {
+    if (!ok) {
+        throw std::runtime_error(what);
+    }
+}
+
+std::string read_file(const std::string &filename) {
+    std::ifstream in(filename, std::ios::binary);
+    expect(static_cast<bool>(in), "missing output " + filename);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string &filename, const std::string &data) {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+    expect(static_cast<bool>(out), "cannot write " + filename);
+}
+
+} // namespace
+
+// Function to parse `data` as a container and decrypt everything it claims to hold, through the
+// in-memory view and through the file reader with ranges; malformed input must end in an
+// exception, never a crash or an out-of-bounds access
+int fuzz_container(const uint8_t *data, std::size_t size) {
+    // Plaintext a fuzz input may claim before it is skipped, so claims cannot exhaust memory
+    constexpr uint64_t MAX_PLAINTEXT = 64ull << 20;
+    auto decrypt_all = [&](const auto &cipher) {
+        xec::ContainerView view(data, size, "fuzz input");
+        if (view.header().segment_bits != cipher.width || view.header().plaintext_size > MAX_PLAINTEXT) {
+            return;
+        }
+        xec::ChunkVerifier verifier(view.has_checksums(), view.chunk_count());
+        xec::ChunkCodec codec(0);
+        std::string plaintext;
+        for (uint64_t index = 0; index < view.chunk_count(); ++index) {
+            const xec::ChunkEntry &entry = view.entry(index);
+            if (entry.plain_size > MAX_PLAINTEXT) {
+                return;
+            }
+            plaintext.resize(entry.plain_size);
+            uint8_t *out = reinterpret_cast<uint8_t *>(&plaintext[0]);
+            uint32_t expected = verifier.enabled() ? view.checksum(index) : 0;
+            if (view.compressed()) {
+                xec::decrypt_decompress(cipher, codec, view.chunk_data(index), entry.size, out, entry.plain_size, verifier, index, expected);
+            } else if (verifier.enabled()) {
+                verifier.check(index, xec::decrypt_checked(cipher, view.chunk_data(index), out, entry.plain_size, entry.size), expected);
+            } else {
+                cipher.decrypt(view.chunk_data(index), out, entry.plain_size);
+            }
+        }
+    };
+    auto read_ranges = [&](const auto &cipher, const std::string &filename) {
+        xec::ContainerReader reader(filename);
+        const xec::ContainerHeader &header = reader.header();
+        if (header.segment_bits != cipher.width) {
+            return;
+        }
+        uint64_t length = std::min<uint64_t>(header.plaintext_size, MAX_PLAINTEXT);
+        std::string plaintext;
+        xec::ChunkCodec codec(0);
+        for (uint64_t offset : {uint64_t(0), header.plaintext_size / 2, header.plaintext_size - length}) {
+            try {
+                if (reader.compressed()) {
+                    xec::decrypt_compressed_range(reader, offset, std::min(length, header.plaintext_size - offset), plaintext, cipher, codec);
+                } else {
+                    xec::decrypt_range(reader, offset, std::min(length, header.plaintext_size - offset), plaintext, cipher);
+                }
+            } catch (const std::exception &) {
+            }
+        }
+    };
+
+    try {
+        decrypt_all(xec::XecCipher256());
+        decrypt_all(xec::XecCipher128());
+    } catch (const std::exception &) {
+    }
+    static const std::string filename = (std::filesystem::temp_directory_path() / ("xec_fuzz_" + std::to_string(::getpid()) + ".xec")).string();
+    // Removes the input file on every way out, so no run leaves it behind
+    struct RemoveOnExit {
+        const std::string &filename;
+        ~RemoveOnExit() {
+            std::error_code ignored;
+            std::filesystem::remove(filename, ignored);
+        }
+    } remove_on_exit{filename};
+    {
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(data), size);
+    }
+    try {
+        read_ranges(xec::XecCipher256(), filename);
+        read_ranges(xec::XecCipher128(), filename);
+    } catch (const std::exception &) {
+    }
+    return 0;
+}
+
+#ifdef XEC_FUZZ
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, std::size_t size) {
+    return fuzz_container(data, size);
+}
+#else
+
+namespace {
+
+struct CheckOptions {
+    std::size_t cases = 50;
+    uint64_t seed = 1;
+    std::size_t max_size = 256 * 1024;
+    std::string bin_dir;
+    std::string work_dir = "diffcheck";
+};
+
+// Function to check every XOR kernel and the checked encrypt/decrypt passes of `cipher` against
+// the reference on one random input
+template <typename Cipher>
+void check_kernels(const Cipher &cipher, const ReferenceKey &key, std::mt19937_64 &rng, std::size_t max_size) {
+    std::string plaintext = random_bytes(rng, random_size(rng, max_size));
+    std::string expected = reference_encrypt(key, plaintext);
+    const std::string what = std::to_string(key.width) + "-bit key, " + std::to_string(plaintext.size()) + " bytes";
+
+    // Each kernel directly, on a padded copy at a random misalignment
+    struct Kernel {
+        xec::XorMaskFn fn;
+        const char *name;
+        bool available;
+    };
+    std::vector<Kernel> kernels = {{xec::xor_mask_scalar, "scalar", true}};
+#ifdef XEC_KERNEL_X86
+    kernels.push_back({xec::xor_mask_avx2, "avx2", __builtin_cpu_supports("avx2") != 0});
+    kernels.push_back({xec::xor_mask_avx512, "avx512", __builtin_cpu_supports("avx512f") != 0});
+#endif
+    std::size_t shift = rng() % 64;
+    for (const Kernel &kernel : kernels) {
+        if (!kernel.available) {
+            continue;
+        }
+        std::string buffer(shift + expected.size(), '\0');
+        std::memcpy(&buffer[shift], plaintext.data(), plaintext.size());
+        uint8_t *data = reinterpret_cast<uint8_t *>(&buffer[shift]);
+        kernel.fn(cipher.mask, data, data, expected.size());
+        expect(buffer.compare(shift, std::string::npos, expected) == 0, std::string(kernel.name) + " kernel differs from the reference: " + what);
+    }
+
+    // encrypt_padded and the fused CRC pass
+    std::string ciphertext(cipher.padded_size(plaintext.size()), '\0');
+    cipher.encrypt_padded(plaintext.data(), &ciphertext[0], plaintext.size());
+    expect(ciphertext == expected, "encrypt_padded differs from the reference: " + what);
+    std::fill(ciphertext.begin(), ciphertext.end(), '\0');
+    uint32_t crc = xec::encrypt_padded_checked(cipher, plaintext.data(), &ciphertext[0], plaintext.size());
+    expect(ciphertext == expected, "encrypt_padded_checked differs from the reference: " + what);
+    expect(crc == reference_crc32c(expected), "encrypt_padded_checked CRC differs from the reference: " + what);
+    expect(xec::crc32c(reinterpret_cast<const uint8_t *>(expected.data()), expected.size()) == reference_crc32c(expected),
+           "crc32c differs from the reference: " + what);
+
+    // Decrypt straight to the plaintext bytes, separately and in place
+    std::string decrypted(plaintext.size(), '\0');
+    crc = xec::decrypt_checked(cipher, ciphertext.data(), &decrypted[0], plaintext.size(), ciphertext.size());
+    expect(decrypted == plaintext, "decrypt_checked does not restore the plaintext: " + what);
+    expect(crc == reference_crc32c(expected), "decrypt_checked CRC differs from the reference: " + what);
+    cipher.decrypt(ciphertext.data(), &ciphertext[0], plaintext.size());
+    expect(ciphertext.compare(0, plaintext.size(), plaintext) == 0, "in-place decrypt does not restore the plaintext: " + what);
+}
+
+// Function to check the in-memory API on a random batch of messages: every message on its own,
+// in place, and as a batch with and without `pool`, against Cipher::encrypt() and the reference
+template <typename Cipher>
+void check_library(const ReferenceKey &key, std::mt19937_64 &rng, xec::WorkerPool &pool) {
+    // Enough messages that a batch often exceeds BATCH_TASK_BYTES and is split over the pool
+    std::size_t count = rng() % 2 ? rng() % 8 + 1 : rng() % 200 + 1;
+    std::vector<std::string> plaintexts(count);
+    std::vector<std::string> expected(count);
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        plaintexts[i] = random_bytes(rng, 64 + rng() % (16 * 1024 - 64 + 1));
+        expected[i].resize(plaintexts[i].size());
+        Cipher::encrypt(plaintexts[i].data(), &expected[i][0], plaintexts[i].size());
+        total += plaintexts[i].size();
+    }
+    const std::string what = std::to_string(key.width) + "-bit key, " + std::to_string(count) + " messages, " + std::to_string(total) + " bytes";
+    for (std::size_t i = 0; i < count; ++i) {
+        // A message is its zero-padded payload truncated to the plaintext length
+        expect(expected[i] == reference_encrypt(key, plaintexts[i]).substr(0, plaintexts[i].size()),
+               "Cipher::encrypt differs from the reference on message " + std::to_string(i) + ": " + what);
+    }
+
+    auto bytes = [](const std::string &text) { return xec::ConstBytes{reinterpret_cast<const uint8_t *>(text.data()), text.size()}; };
+    auto buffer = [](std::string &text) { return xec::MutableBytes{reinterpret_cast<uint8_t *>(&text[0]), text.size()}; };
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::string where = "message " + std::to_string(i) + " (" + std::to_string(plaintexts[i].size()) + " bytes): " + what;
+        std::string ciphertext(plaintexts[i].size() + rng() % 3, '\0');
+        expect(xec::encrypt<Cipher>(bytes(plaintexts[i]), buffer(ciphertext)) == plaintexts[i].size() &&
+               ciphertext.compare(0, plaintexts[i].size(), expected[i]) == 0, "encrypt() differs on " + where);
+        std::string decrypted(plaintexts[i].size(), '\0');
+        expect(xec::decrypt<Cipher>(bytes(expected[i]), buffer(decrypted)) == plaintexts[i].size() && decrypted == plaintexts[i],
+               "decrypt() does not restore " + where);
+        std::string in_place = plaintexts[i];
+        xec::encrypt<Cipher>(bytes(in_place), buffer(in_place));
+        expect(in_place == expected[i], "in-place encrypt() differs on " + where);
+        bool rejected = false;
+        try {
+            std::string small(plaintexts[i].size() - 1, '\0');
+            xec::encrypt<Cipher>(bytes(plaintexts[i]), buffer(small));
+        } catch (const std::invalid_argument &) {
+            rejected = true;
+        }
+        expect(rejected, "encrypt() accepted a short output buffer for " + where);
+    }
+
+    // Batches write into one arena with every message at an odd offset
+    for (xec::WorkerPool *batch_pool : {static_cast<xec::WorkerPool *>(nullptr), &pool}) {
+        const std::string how = batch_pool ? "on the pool" : "inline";
+        std::string arena(total + 64 * count, '\0');
+        std::vector<xec::BatchMessage> messages(count);
+        std::vector<std::size_t> offsets(count);
+        for (std::size_t i = 0, at = 0; i < count; ++i) {
+            at += rng() % 63 + 1;
+            offsets[i] = at;
+            messages[i] = xec::BatchMessage{reinterpret_cast<const uint8_t *>(plaintexts[i].data()),
+                                            reinterpret_cast<uint8_t *>(&arena[at]), plaintexts[i].size()};
+            at += plaintexts[i].size();
+        }
+        xec::encrypt_batch<Cipher>(messages.data(), count, batch_pool);
+        for (std::size_t i = 0; i < count; ++i) {
+            expect(arena.compare(offsets[i], expected[i].size(), expected[i]) == 0,
+                   "encrypt_batch() " + how + " differs on message " + std::to_string(i) + ": " + what);
+            messages[i].in = messages[i].out; // decrypt in place
+        }
+        xec::decrypt_batch<Cipher>(messages.data(), count, batch_pool);
+        for (std::size_t i = 0; i < count; ++i) {
+            expect(arena.compare(offsets[i], plaintexts[i].size(), plaintexts[i]) == 0,
+                   "decrypt_batch() " + how + " does not restore message " + std::to_string(i) + ": " + what);
+        }
+    }
+}
+
+// Function to write `plaintext` as a container of `chunk_size` chunks, as the streaming encryptors
+// do, check each payload and checksum against the reference, and read it back whole and by range
+template <typename Cipher>
+void check_container_round_trip(const Cipher &cipher, const ReferenceKey &key, const std::string &plaintext, std::size_t chunk_size,
+                                bool compress, std::mt19937_64 &rng, const std::string &filename) {
+    const std::string what = std::to_string(key.width) + "-bit key, " + std::to_string(plaintext.size()) + " bytes, " +
+                             std::to_string(chunk_size) + "-byte chunks" + (compress ? ", compressed" : "");
+    {
+        xec::ContainerWriter writer(filename, cipher.width, chunk_size);
+        writer.enable_checksums();
+        if (compress) {
+            writer.enable_compression();
+        }
+        xec::ChunkCodec codec(6);
+        std::string payload;
+        for (std::size_t offset = 0, index = 0; offset < plaintext.size(); offset += chunk_size, ++index) {
+            std::string chunk = plaintext.substr(offset, chunk_size);
+            uint32_t crc;
+            if (compress) {
+                std::size_t stream = xec::compress_chunk(cipher, codec, chunk, payload);
+                crc = xec::encrypt_padded_checked(cipher, payload.data(), &payload[0], stream);
+            } else {
+                payload.resize(cipher.padded_size(chunk.size()));
+                crc = xec::encrypt_padded_checked(cipher, chunk.data(), &payload[0], chunk.size());
+                expect(payload == reference_encrypt(key, chunk), "chunk " + std::to_string(index) + " differs from the reference: " + what);
+            }
+            expect(crc == reference_crc32c(payload), "chunk " + std::to_string(index) + " CRC differs from the reference: " + what);
+            writer.write_chunk(index, payload, chunk.size(), crc);
+        }
+        writer.finish();
+    }
+
+    xec::ContainerReader reader(filename);
+    expect(reader.header().plaintext_size == plaintext.size(), "container records the wrong plaintext size: " + what);
+    expect(reader.chunk_count() == (plaintext.size() + chunk_size - 1) / chunk_size, "container records the wrong chunk count: " + what);
+    xec::ChunkCodec codec(0);
+    std::string whole;
+    if (compress) {
+        xec::decrypt_compressed_range(reader, 0, plaintext.size(), whole, cipher, codec);
+    } else {
+        xec::decrypt_range(reader, 0, plaintext.size(), whole, cipher);
+    }
+    expect(whole == plaintext, "whole-file read does not restore the plaintext: " + what);
+    for (int round = 0; round < 8 && !plaintext.empty(); ++round) {
+        uint64_t offset = rng() % (plaintext.size() + 1);
+        uint64_t length = rng() % (plaintext.size() - offset + 1);
+        std::string range;
+        if (compress) {
+            xec::decrypt_compressed_range(reader, offset, length, range, cipher, codec);
+        } else {
+            xec::decrypt_range(reader, offset, length, range, cipher);
+        }
+        expect(range == plaintext.substr(offset, length),
+               "range " + std::to_string(offset) + "+" + std::to_string(length) + " differs: " + what);
+    }
+}
+
+// Function to corrupt a valid container in several ways and run each through fuzz_container()
+void check_parsers(const std::string &container, std::mt19937_64 &rng) {
+    std::vector<std::string> inputs = {container, container.substr(0, container.size() / 2), container + container};
+    for (int round = 0; round < 24; ++round) {
+        std::string damaged = container;
+        // Header and index bytes are where parsers go wrong; hit them more often than payloads
+        std::size_t flips = rng() % 4 + 1;
+        for (std::size_t i = 0; i < flips && !damaged.empty(); ++i) {
+            std::size_t at = rng() % 2 ? rng() % std::min<std::size_t>(damaged.size(), sizeof(xec::ContainerHeader))
+                                       : damaged.size() - 1 - rng() % std::min<std::size_t>(damaged.size(), 256);
+            damaged[at] = static_cast<char>(rng());
+        }
+        if (rng() % 4 == 0) {
+            damaged.resize(rng() % (damaged.size() + 1));
+        }
+        inputs.push_back(damaged);
+    }
+    for (const std::string &input : inputs) {
+        fuzz_container(reinterpret_cast<const uint8_t *>(input.data()), input.size());
+    }
+}
+
+// Function to run `command` from `dir`, its output going to `log`; the engines report per-file
+// errors on stderr and carry on, so callers judge a run by the files it leaves
+void run(const std::string &dir, const std::string &command, const std::string &log) {
+    std::string line = "cd '" + dir + "' && " + command + " > '" + log + "' 2>&1";
+    expect(std::system(line.c_str()) == 0, "command failed (see " + dir + "/" + log + "): " + command);
+}
+
+// Function to check a container an engine wrote against the reference containers of `plaintext`
+void check_engine_container(const std::string &filename, const ReferenceKey &key, const std::string &key_id, const std::string &plaintext,
+                            std::size_t chunk_size, const std::string &what) {
+    xec::ContainerReader reader(filename);
+    const xec::ContainerHeader &header = reader.header();
+    expect(header.segment_bits == key.width, what + ": wrong segment width in " + filename);
+    expect(header.chunk_size == chunk_size, what + ": wrong chunk size in " + filename);
+    expect(header.plaintext_size == plaintext.size(), what + ": wrong plaintext size in " + filename);
+    expect(xec::container_key_id(header) == key_id, what + ": wrong key ID in " + filename);
+    expect(reader.chunk_count() == (plaintext.size() + chunk_size - 1) / chunk_size, what + ": wrong chunk count in " + filename);
+    std::string payload;
+    for (uint64_t index = 0; index < reader.chunk_count(); ++index) {
+        std::string chunk = plaintext.substr(index * chunk_size, chunk_size);
+        reader.read_chunk(index, payload);
+        expect(reader.entry(index).plain_size == chunk.size(), what + ": chunk " + std::to_string(index) + " has the wrong length in " + filename);
+        if (reader.compressed()) {
+            continue; // deflate output is zlib's business; the decryptors' round trip covers it
+        }
+        expect(payload == reference_encrypt(key, chunk), what + ": chunk " + std::to_string(index) + " differs from the reference in " + filename);
+        expect(reader.has_checksums() && reader.checksum(index) == reference_crc32c(payload),
+               what + ": chunk " + std::to_string(index) + " has the wrong CRC in " + filename);
+    }
+}
+
+// Function to run the four binaries on one random configuration and check every output; returns
+// false when --io uring was asked for but ParaEn was built without liburing
+bool check_engines(const CheckOptions &options, std::mt19937_64 &rng, const std::string &dir) {
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir + "/dataset");
+    std::filesystem::create_directories(dir + "/output");
+    std::filesystem::create_directories(dir + "/plaintext");
+    // ParaEn and XecLDS_SDS encrypt dataset/D4.txt and dataset/D5.txt
+    const std::string d4 = random_bytes(rng, random_size(rng, options.max_size));
+    const std::string d5 = random_bytes(rng, random_size(rng, options.max_size));
+    write_file(dir + "/dataset/D4.txt", d4);
+    write_file(dir + "/dataset/D5.txt", d5);
+
+    static const std::size_t chunk_sizes[] = {1, 15, 16, 33, 1000, 4096, 65536 + 13};
+    std::size_t chunk_size = rng() % 4 ? chunk_sizes[rng() % 7] : rng() % 300000 + 1;
+    // Keep the chunk count (and the engines' run time) bounded on tiny chunk sizes
+    chunk_size = std::max<std::size_t>(chunk_size, std::max(d4.size(), d5.size()) / 2048);
+    static const char *threads[] = {"1", "2", "3", "8"};
+    static const char *in_flight[] = {"1", "2", "5", "16"};
+    static const char *io[] = {"stream", "mmap", "uring"};
+    std::string thread_count = threads[rng() % 4];
+    std::string depth = in_flight[rng() % 4];
+    std::string backend = io[rng() % 3];
+    bool compress = rng() % 4 == 0;
+    bool use_key_file = rng() % 3 == 0;
+    const std::string what = "threads " + thread_count + ", in-flight " + depth + ", io " + backend + ", chunk " + std::to_string(chunk_size) +
+                             (compress ? ", compressed" : "") + (use_key_file ? ", key file" : "");
+
+    ReferenceKey key = REFERENCE_256;
+    std::string key_args;
+    if (use_key_file) {
+        key = random_key(rng, 256);
+        write_file(dir + "/keys.txt", "diff " + std::to_string(key.width) + " " + key.bits + " " + join_positions(key.mutations) + "\n");
+        key_args = " --key-file keys.txt";
+    }
+    std::string bin = std::filesystem::absolute(options.bin_dir).string() + "/";
+    std::string common = " --threads " + thread_count + " --in-flight " + depth + " --io " + backend;
+    run(dir, bin + "ParaEn" + common + " --chunk-size " + std::to_string(chunk_size) + (compress ? " --compress 6" : "") +
+             (use_key_file ? key_args + " --key-id diff" : ""), "ParaEn.log");
+    bool uring_fell_back = backend == "uring" && read_file(dir + "/ParaEn.log").find("Built without liburing") != std::string::npos;
+    run(dir, bin + "XecLDS_SDS --in-flight " + depth + " --io " + (backend == "mmap" ? "mmap" : "stream") + " --chunk-size " +
+             std::to_string(chunk_size) + (compress ? " --compress 6" : ""), "XecLDS_SDS.log");
+    for (const auto &input : {std::make_pair("D4", &d4), std::make_pair("D5", &d5)}) {
+        check_engine_container(dir + "/output/encrypted_" + input.first + ".xec", key, use_key_file ? "diff" : "", *input.second, chunk_size,
+                               "ParaEn (" + what + ")");
+        check_engine_container(dir + "/output/encrypted128_" + input.first + ".xec", REFERENCE_128, "", *input.second, chunk_size,
+                               "XecLDS_SDS (" + what + ")");
+    }
+
+    std::string decrypt_io = backend == "mmap" ? "mmap" : "stream";
+    run(dir, bin + "ParaDec --threads " + thread_count + " --in-flight " + depth + " --io " + decrypt_io + key_args, "ParaDec.log");
+    run(dir, bin + "ParaDec --threads " + thread_count + " --prefix encrypted128_ --io " + decrypt_io, "ParaDec128.log");
+    for (const auto &input : {std::make_pair("D4", &d4), std::make_pair("D5", &d5)}) {
+        expect(read_file(dir + "/plaintext/decrypted_" + input.first + ".txt") == *input.second,
+               std::string("ParaDec does not restore ") + input.first + " from ParaEn (" + what + ")");
+        expect(read_file(dir + "/plaintext/decrypted128_" + input.first + ".txt") == *input.second,
+               std::string("ParaDec does not restore ") + input.first + " from XecLDS_SDS (" + what + ")");
+    }
+    if (!use_key_file) {
+        std::filesystem::remove(dir + "/plaintext/decrypted_D4.txt");
+        std::filesystem::remove(dir + "/plaintext/decrypted_D5.txt");
+        run(dir, bin + "XEC_Dec_LDS --io " + decrypt_io, "XEC_Dec_LDS.log");
+        for (const auto &input : {std::make_pair("D4", &d4), std::make_pair("D5", &d5)}) {
+            expect(read_file(dir + "/plaintext/decrypted_" + input.first + ".txt") == *input.second,
+                   std::string("XEC_Dec_LDS does not restore ") + input.first + " from ParaEn (" + what + ")");
+        }
+    }
+
+    // One range inside both files, through both range decryptors
+    uint64_t shorter = std::min(d4.size(), d5.size());
+    uint64_t offset = rng() % (shorter + 1);
+    uint64_t length = rng() % (shorter - offset + 1);
+    std::string range_args = " --range " + std::to_string(offset) + " " + std::to_string(length);
+    auto check_range = [&](const std::string &engine) {
+        for (const auto &input : {std::make_pair("D4", &d4), std::make_pair("D5", &d5)}) {
+            std::string filename = dir + "/plaintext/decrypted_" + input.first + "_range.txt";
+            expect(read_file(filename) == input.second->substr(offset, length),
+                   engine + range_args + " of " + input.first + " differs (" + what + ")");
+            std::filesystem::remove(filename);
+        }
+    };
+    run(dir, bin + "ParaDec" + range_args + key_args, "ParaDecRange.log");
+    check_range("ParaDec");
+    if (!use_key_file) {
+        run(dir, bin + "XEC_Dec_LDS" + range_args, "XEC_Dec_LDSRange.log");
+        check_range("XEC_Dec_LDS");
+    }
+    return !uring_fell_back;
+}
+
+#ifdef XEC_HAVE_LIBURING
+// Function to copy a random file through UringChunkReader and UringChunkWriter, rotating chunks
+// through `depth` slot strings as the pipelines do, and check what was read and written
+void check_uring(std::mt19937_64 &rng, std::size_t max_size, const std::string &dir) {
+    const std::string data = random_bytes(rng, random_size(rng, max_size));
+    std::size_t chunk_size = rng() % 2 ? rng() % 5000 + 1 : rng() % 200000 + 1;
+    std::size_t depth = rng() % 8 + 1;
+    const std::string what = std::to_string(data.size()) + " bytes, " + std::to_string(chunk_size) + "-byte chunks, depth " + std::to_string(depth);
+    write_file(dir + "/uring_in.bin", data);
+    write_file(dir + "/uring_out.bin", "");
+    std::vector<std::string> slots(depth);
+    {
+        xec::UringChunkReader reader(dir + "/uring_in.bin", chunk_size, depth);
+        xec::UringChunkWriter writer(dir + "/uring_out.bin", chunk_size, depth);
+        uint64_t offset = 0;
+        for (uint64_t sequence = 0;; ++sequence) {
+            std::string &slot = slots[sequence % depth];
+            if (!reader.next(slot)) {
+                break;
+            }
+            expect(slot == data.substr(offset, chunk_size), "uring read of chunk " + std::to_string(sequence) + " differs: " + what);
+            std::size_t size = slot.size();
+            writer.write(offset, slot);
+            offset += size;
+        }
+        expect(offset == data.size(), "uring reader stopped after " + std::to_string(offset) + " bytes: " + what);
+        writer.drain();
+    }
+    expect(read_file(dir + "/uring_out.bin") == data, "uring writes differ from the chunks given: " + what);
+}
+#endif
+
+int run_checks(const CheckOptions &options) {
+    std::filesystem::create_directories(options.work_dir);
+    const xec::KeySchedule builtin256 = xec::KeySchedule::from_cipher<xec::XecCipher256>();
+    std::size_t engine_runs = 0;
+    std::size_t uring_fallbacks = 0;
+    xec::WorkerPool pool(4);
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t index = 0; index < options.cases; ++index) {
+        uint64_t seed = options.seed + index;
+        std::mt19937_64 rng(seed);
+        try {
+            check_kernels(xec::XecCipher256(), REFERENCE_256, rng, options.max_size);
+            check_kernels(xec::XecCipher128(), REFERENCE_128, rng, options.max_size);
+            check_kernels(builtin256, REFERENCE_256, rng, options.max_size);
+            std::size_t width = rng() % 3 == 0 ? 512 : (rng() % 2 ? 256 : 128);
+            ReferenceKey key = random_key(rng, width);
+            check_kernels(xec::KeySchedule("diff", key.width, key.bits, key.mutations), key, rng, options.max_size);
+            check_library<xec::XecCipher256>(REFERENCE_256, rng, pool);
+            check_library<xec::XecCipher128>(REFERENCE_128, rng, pool);
+
+            std::string plaintext = random_bytes(rng, random_size(rng, options.max_size));
+            std::size_t chunk_size = rng() % 2 ? rng() % 5000 + 1 : rng() % 200000 + 1;
+            std::string filename = options.work_dir + "/case.xec";
+            check_container_round_trip(xec::XecCipher256(), REFERENCE_256, plaintext, chunk_size, false, rng, filename);
+            check_parsers(read_file(filename), rng);
+            if (xec::COMPRESSION_AVAILABLE) {
+                check_container_round_trip(xec::XecCipher128(), REFERENCE_128, plaintext, chunk_size, true, rng, filename);
+                check_parsers(read_file(filename), rng);
+            }
+#ifdef XEC_HAVE_LIBURING
+            check_uring(rng, options.max_size, options.work_dir);
+#endif
+            if (!options.bin_dir.empty()) {
+                if (!check_engines(options, rng, options.work_dir + "/engines")) {
+                    ++uring_fallbacks;
+                }
+                ++engine_runs;
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "FAIL case " << index << ": " << e.what() << "\n"
+                      << "  replay with --seed " << seed << " --cases 1" << std::endl;
+            return 1;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "OK: " << options.cases << " cases (" << engine_runs << " engine runs), kernel " << xec::active_kernel().name
+              << ", " << elapsed << " s" << std::endl;
+    if (uring_fallbacks) {
+        std::cout << "  " << uring_fallbacks << " --io uring engine runs used streams: rebuild the binaries with -DXEC_HAVE_LIBURING -luring" << std::endl;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    CheckOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--cases") {
+            options.cases = std::stoul(value);
+        } else if (flag == "--seed") {
+            options.seed = std::stoull(value);
+        } else if (flag == "--max-size") {
+            options.max_size = std::stoul(value);
+        } else if (flag == "--bin-dir") {
+            options.bin_dir = value;
+        } else if (flag == "--work-dir") {
+            options.work_dir = value;
+        } else {
+            std::cerr << "Unknown option " << flag << std::endl;
+            return 1;
+        }
+    }
+    try {
+        return run_checks(options);
+    } catch (const std::exception &e) {
+        std::cerr << "FAIL: " << e.what() << std::endl;
+        return 1;
+    }
+}
+
+#endif
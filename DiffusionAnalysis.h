@@ -0,0 +1,340 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "SegmentKernel.h"
+#include "WorkerPool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Avalanche / diffusion analysis of a segment cipher.
+//
+// The "Average Avalanche Effect" the encryptors print is the share of bits that differ between
+// a segment and its own ciphertext, a constant of the key. Diffusion asks something else: when
+// one plaintext bit flips, how many ciphertext bits flip, and which ones? For every sampled
+// plaintext segment the analysis builds a batch of copies, each with one input bit flipped,
+// encrypts the batch through the SIMD kernel, XORs it with the unflipped segment's ciphertext
+// (the same kernel, with that ciphertext as the mask) and counts the differing bits of each
+// copy with a vector popcount. Per input bit position it keeps the mean, spread and range of
+// output bits changed, and per (input, output) bit pair how often the output bit flipped: the
+// strict avalanche criterion (SAC) wants every pair near 1/2 and a mean of width / 2 bits.
+//
+// Samples are whole segments at seeded pseudo-random positions of the input, so the cost
+// follows the sample count, not the file size, and a run is reproducible for a given seed
+// whatever the thread count. Each worker counts into its own slot; slots are summed at the end.
+// Bit positions use the key file numbering: bit 0 is the low bit of a segment's last byte.
+namespace xec {
+
+// Portable fallback: one popcount per 64-bit word
+inline void popcount_words_scalar(const uint8_t *data, std::size_t words, uint32_t *counts) {
+    for (std::size_t w = 0; w < words; ++w) {
+        uint64_t value;
+        std::memcpy(&value, data + w * 8, 8);
+        counts[w] = static_cast<uint32_t>(__builtin_popcountll(value));
+    }
+}
+
+#ifdef XEC_KERNEL_X86
+// Nibble lookup popcount; vpsadbw sums each 64-bit lane's bytes
+__attribute__((target("avx2")))
+inline void popcount_words_avx2(const uint8_t *data, std::size_t words, uint32_t *counts) {
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    std::size_t w = 0;
+    for (; w + 4 <= words; w += 4) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + w * 8));
+        __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(table, _mm256_and_si256(v, low)),
+                                        _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+        for (std::size_t lane = 0; lane < 4; ++lane) {
+            counts[w + lane] = static_cast<uint32_t>(lanes[lane]);
+        }
+    }
+    popcount_words_scalar(data + w * 8, words - w, counts + w);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+inline void popcount_words_avx512(const uint8_t *data, std::size_t words, uint32_t *counts) {
+    std::size_t w = 0;
+    for (; w + 8 <= words; w += 8) {
+        alignas(64) uint64_t lanes[8];
+        _mm512_store_si512(lanes, _mm512_popcnt_epi64(_mm512_loadu_si512(data + w * 8)));
+        for (std::size_t lane = 0; lane < 8; ++lane) {
+            counts[w + lane] = static_cast<uint32_t>(lanes[lane]);
+        }
+    }
+    popcount_words_scalar(data + w * 8, words - w, counts + w);
+}
+#endif
+
+using PopcountWordsFn = void (*)(const uint8_t *, std::size_t, uint32_t *);
+
+struct PopcountChoice {
+    PopcountWordsFn fn;
+    const char *name;
+};
+
+// Function to pick the widest popcount the CPU supports; XEC_KERNEL=scalar|avx2|avx512 caps it
+// as it does the cipher kernel
+inline PopcountChoice select_popcount() {
+    const char *forced = std::getenv("XEC_KERNEL");
+    std::string want = forced ? forced : "";
+#ifdef XEC_KERNEL_X86
+    __builtin_cpu_init();
+    bool has_vpopcnt = __builtin_cpu_supports("avx512vpopcntdq");
+    bool has_avx2 = __builtin_cpu_supports("avx2");
+    if ((want.empty() || want == "avx512") && has_vpopcnt) {
+        return {popcount_words_avx512, "avx512"};
+    }
+    if ((want.empty() || want == "avx2" || want == "avx512") && has_avx2) {
+        return {popcount_words_avx2, "avx2"};
+    }
+#endif
+    return {popcount_words_scalar, "scalar"};
+}
+
+inline const PopcountChoice &active_popcount() {
+    static const PopcountChoice choice = select_popcount();
+    return choice;
+}
+
+struct DiffusionOptions {
+    uint64_t samples = 65536;           // plaintext segments sampled
+    std::size_t bits_per_sample = 0;    // input bits flipped per segment; 0 flips every bit
+    uint64_t seed = 1;
+};
+
+// Output bits changed by flipping one input bit position, over every sample that flipped it
+struct BitDiffusion {
+    uint64_t trials = 0;
+    uint64_t changed = 0;           // sum of output bits changed
+    uint64_t changed_squares = 0;   // sum of their squares, for the spread
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+
+    double mean() const { return trials ? static_cast<double>(changed) / trials : 0.0; }
+    double stddev() const {
+        if (trials == 0) {
+            return 0.0;
+        }
+        double m = mean();
+        return std::sqrt(std::max(0.0, static_cast<double>(changed_squares) / trials - m * m));
+    }
+
+    void add(const BitDiffusion &other) {
+        trials += other.trials;
+        changed += other.changed;
+        changed_squares += other.changed_squares;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+};
+
+struct DiffusionReport {
+    std::size_t width = 0;
+    uint64_t samples = 0;
+    std::vector<BitDiffusion> inputs;   // by input bit position
+    std::vector<uint64_t> pair_flips;   // [input * width + output]: times output flipped with input
+
+    // Function to total every input position
+    BitDiffusion overall() const {
+        BitDiffusion sum;
+        for (const BitDiffusion &bit : inputs) {
+            sum.add(bit);
+        }
+        return sum;
+    }
+
+    // Mean output bits changed per flipped input bit, as a percentage of the width (ideal 50)
+    double avalanche_effect() const { return width ? overall().mean() / width * 100.0 : 0.0; }
+
+    // Function to compute |P(output flips | input flipped) - 1/2| of one pair
+    double sac_deviation(std::size_t input, std::size_t output) const {
+        uint64_t trials = inputs[input].trials;
+        return trials ? std::fabs(static_cast<double>(pair_flips[input * width + output]) / trials - 0.5) : 0.0;
+    }
+
+    // Function to average sac_deviation() over the pairs of one input (0 ideal, 0.5 worst)
+    double sac_deviation(std::size_t input) const {
+        double sum = 0.0;
+        for (std::size_t output = 0; output < width; ++output) {
+            sum += sac_deviation(input, output);
+        }
+        return sum / width;
+    }
+
+    // Function to average and bound sac_deviation() over every tested pair
+    void sac_summary(double &mean, double &worst) const {
+        mean = worst = 0.0;
+        std::size_t tested = 0;
+        for (std::size_t input = 0; input < width; ++input) {
+            if (inputs[input].trials == 0) {
+                continue;
+            }
+            ++tested;
+            for (std::size_t output = 0; output < width; ++output) {
+                double deviation = sac_deviation(input, output);
+                mean += deviation;
+                worst = std::max(worst, deviation);
+            }
+        }
+        mean = tested ? mean / (tested * width) : 0.0;
+    }
+};
+
+// Deterministic per-task stream (xorshift64*, seeded through splitmix64)
+class SampleRng {
+public:
+    SampleRng(uint64_t seed, uint64_t stream) {
+        uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        state_ = (z ^ (z >> 31)) | 1;
+    }
+
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1Dull;
+    }
+
+    // Function to draw uniformly from [0, bound)
+    uint64_t below(uint64_t bound) { return static_cast<uint64_t>((static_cast<unsigned __int128>(next()) * bound) >> 64); }
+
+private:
+    uint64_t state_;
+};
+
+// Function to measure the diffusion of `cipher` over segments sampled from `data` (`size` bytes,
+// at least one segment); with `data` null the segments are random. Samples are split into
+// fixed tasks seeded by their index and run on `pool`.
+template <typename Cipher>
+DiffusionReport analyze_diffusion(const Cipher &cipher, const uint8_t *data, uint64_t size, const DiffusionOptions &options, WorkerPool &pool) {
+    const std::size_t width = cipher.width;
+    const std::size_t segment_bytes = cipher.segment_bytes;
+    const std::size_t words = segment_bytes / 8;
+    const std::size_t bits_per_sample = options.bits_per_sample ? std::min(options.bits_per_sample, width) : width;
+    if (data && size < segment_bytes) {
+        throw std::runtime_error("Input is smaller than one " + std::to_string(width) + "-bit segment");
+    }
+    const uint64_t segments = data ? size / segment_bytes : 0;
+
+    // Per worker (plus the calling thread): counters and batch buffers, allocated once
+    struct Slot {
+        std::vector<BitDiffusion> inputs;
+        std::vector<uint64_t> pair_flips;
+        std::vector<uint8_t> batch;
+        std::vector<uint32_t> counts;
+        std::vector<std::size_t> positions;
+    };
+    std::vector<std::unique_ptr<Slot>> slots(pool.size() + 1);
+
+    constexpr uint64_t SAMPLES_PER_TASK = 256;
+    const PopcountWordsFn popcount = active_popcount().fn;
+    auto run_task = [&](uint64_t task) {
+        std::unique_ptr<Slot> &slot = slots[pool.current_worker()];
+        if (!slot) {
+            slot.reset(new Slot());
+            slot->inputs.resize(width);
+            slot->pair_flips.resize(width * width);
+            slot->batch.resize((bits_per_sample + 1) * segment_bytes);
+            slot->counts.resize(bits_per_sample * words);
+            slot->positions.resize(width);
+        }
+        Slot &s = *slot;
+        SampleRng rng(options.seed, task);
+        uint8_t *base = s.batch.data() + bits_per_sample * segment_bytes;
+        uint64_t end = std::min(options.samples, (task + 1) * SAMPLES_PER_TASK);
+        for (uint64_t sample = task * SAMPLES_PER_TASK; sample < end; ++sample) {
+            if (data) {
+                std::memcpy(base, data + rng.below(segments) * segment_bytes, segment_bytes);
+            } else {
+                for (std::size_t w = 0; w < words; ++w) {
+                    uint64_t value = rng.next();
+                    std::memcpy(base + w * 8, &value, 8);
+                }
+            }
+            // Input positions: all of them, or a partial Fisher-Yates draw of bits_per_sample
+            for (std::size_t bit = 0; bit < width; ++bit) {
+                s.positions[bit] = bit;
+            }
+            if (bits_per_sample < width) {
+                for (std::size_t i = 0; i < bits_per_sample; ++i) {
+                    std::swap(s.positions[i], s.positions[i + rng.below(width - i)]);
+                }
+            }
+            for (std::size_t i = 0; i < bits_per_sample; ++i) {
+                uint8_t *copy = s.batch.data() + i * segment_bytes;
+                std::memcpy(copy, base, segment_bytes);
+                detail::flip_mask_bit(copy, segment_bytes, s.positions[i]);
+            }
+            // Encrypt the copies and the base in one pass, then XOR the copies with the base ciphertext
+            cipher.encrypt(s.batch.data(), s.batch.data(), s.batch.size());
+            uint8_t base_cipher[MASK_BLOCK_BYTES];
+            std::memcpy(base_cipher, base, segment_bytes);
+            SegmentMask difference = make_segment_mask(base_cipher, segment_bytes);
+            apply_segment_mask(difference, s.batch.data(), s.batch.data(), bits_per_sample * segment_bytes);
+            popcount(s.batch.data(), bits_per_sample * words, s.counts.data());
+
+            for (std::size_t i = 0; i < bits_per_sample; ++i) {
+                const uint8_t *diff = s.batch.data() + i * segment_bytes;
+                uint32_t changed = 0;
+                for (std::size_t w = 0; w < words; ++w) {
+                    changed += s.counts[i * words + w];
+                }
+                BitDiffusion &input = s.inputs[s.positions[i]];
+                ++input.trials;
+                input.changed += changed;
+                input.changed_squares += static_cast<uint64_t>(changed) * changed;
+                input.min = std::min(input.min, changed);
+                input.max = std::max(input.max, changed);
+                uint64_t *row = s.pair_flips.data() + s.positions[i] * width;
+                for (std::size_t w = 0; w < words; ++w) {
+                    uint64_t value;
+                    std::memcpy(&value, diff + w * 8, 8);
+                    for (; value != 0; value &= value - 1) {
+                        // Little-endian word: bit b of byte k is segment byte w * 8 + k
+                        std::size_t bit = static_cast<std::size_t>(__builtin_ctzll(value));
+                        std::size_t byte = w * 8 + bit / 8;
+                        ++row[(segment_bytes - 1 - byte) * 8 + bit % 8];
+                    }
+                }
+            }
+        }
+    };
+
+    uint64_t tasks = (options.samples + SAMPLES_PER_TASK - 1) / SAMPLES_PER_TASK;
+    detail::run_chunk_tasks(&pool, tasks, run_task);
+
+    DiffusionReport report;
+    report.width = width;
+    report.samples = options.samples;
+    report.inputs.resize(width);
+    report.pair_flips.assign(width * width, 0);
+    for (const std::unique_ptr<Slot> &slot : slots) {
+        if (!slot) {
+            continue;
+        }
+        for (std::size_t bit = 0; bit < width; ++bit) {
+            report.inputs[bit].add(slot->inputs[bit]);
+        }
+        for (std::size_t pair = 0; pair < width * width; ++pair) {
+            report.pair_flips[pair] += slot->pair_flips[pair];
+        }
+    }
+    return report;
+}
+
+} // namespace xec
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SegmentCipher.h"
+
+// Runtime keys, so a key can be rotated without recompiling.
+//
+// A key file has one key per line ('#' starts a comment):
+//   <key-id> <width> <key-bits> [<mutation positions, comma separated>]
+// e.g. "k2024a 256 110100...101 50,100,150". KeyRing::schedule() compiles a key on first use
+// into the same combined crossover/mutation mask SegmentCipher builds at compile time and
+// caches it by ID: per-segment work is one XOR with the mask however many mutation positions
+// a key has, and every encryptor and decryptor using the ring shares one compiled schedule.
+// Key bits follow the SegmentCipher rules (most significant bit first, at most `width` used).
+namespace xec {
+
+// Key IDs are stored NUL-padded in the container header
+constexpr std::size_t MAX_KEY_ID_LENGTH = 16;
+
+// A compiled key: the same interface as SegmentCipher, with members in place of statics
+class KeySchedule {
+public:
+    std::string key_id;             // empty for the built-in keys
+    std::size_t width;
+    std::size_t segment_bytes;
+    std::size_t flipped_bits = 0;   // bits changed per segment
+    SegmentMask mask;
+
+    KeySchedule(const std::string &id, std::size_t segment_width, const std::string &bits, const std::vector<std::size_t> &mutation_positions)
+        : key_id(id), width(segment_width), segment_bytes(segment_width / 8), mask() {
+        if (width != 128 && width != 256 && width != 512) {
+            throw std::invalid_argument("Key " + key_id + ": segment width must be 128, 256 or 512 bits");
+        }
+        if (bits.find_first_not_of("01") != std::string::npos) {
+            throw std::invalid_argument("Key " + key_id + ": key bits must be '0' or '1'");
+        }
+        uint8_t bytes[MASK_BLOCK_BYTES] = {};
+        detail::apply_key_bits(bytes, width, bits.data(), bits.size());
+        for (std::size_t position : mutation_positions) {
+            if (position >= width) {
+                throw std::invalid_argument("Key " + key_id + ": mutation position " + std::to_string(position) + " outside the segment");
+            }
+            detail::flip_mask_bit(bytes, segment_bytes, position);
+        }
+        mask = make_segment_mask(bytes, segment_bytes);
+        flipped_bits = mask.flipped_bits;
+    }
+
+    // Function to wrap a compile-time cipher (a built-in key) as a schedule with an empty key ID
+    template <typename Cipher>
+    static KeySchedule from_cipher() {
+        return KeySchedule(Cipher::mask);
+    }
+
+    std::size_t padded_size(std::size_t size) const { return (size + segment_bytes - 1) / segment_bytes * segment_bytes; }
+
+    // Same contracts as SegmentCipher::encrypt / encrypt_padded / decrypt
+    void encrypt(const uint8_t *in, uint8_t *out, std::size_t size) const { apply_segment_mask(mask, in, out, size); }
+    void encrypt(const char *in, char *out, std::size_t size) const { apply_segment_mask(mask, in, out, size); }
+
+    void encrypt_padded(const uint8_t *in, uint8_t *out, std::size_t size) const {
+        std::size_t whole = size / segment_bytes * segment_bytes;
+        apply_segment_mask(mask, in, out, whole);
+        if (whole < size) {
+            uint8_t tail[MASK_BLOCK_BYTES] = {};
+            std::memcpy(tail, in + whole, size - whole);
+            apply_segment_mask(mask, tail, out + whole, segment_bytes);
+        }
+    }
+    void encrypt_padded(const char *in, char *out, std::size_t size) const {
+        encrypt_padded(reinterpret_cast<const uint8_t *>(in), reinterpret_cast<uint8_t *>(out), size);
+    }
+
+    void decrypt(const uint8_t *in, uint8_t *out, std::size_t size) const { apply_segment_mask(mask, in, out, size); }
+    void decrypt(const char *in, char *out, std::size_t size) const { apply_segment_mask(mask, in, out, size); }
+
+private:
+    explicit KeySchedule(const SegmentMask &compiled)
+        : width(compiled.segment_bytes * 8), segment_bytes(compiled.segment_bytes), flipped_bits(compiled.flipped_bits), mask(compiled) {}
+};
+
+// The keys of one key file; each is compiled the first time it is asked for
+class KeyRing {
+public:
+    explicit KeyRing(const std::string &filename) {
+        std::ifstream in(filename);
+        if (!in) {
+            throw std::runtime_error("Cannot open key file: " + filename);
+        }
+        std::string line;
+        for (std::size_t line_number = 1; std::getline(in, line); ++line_number) {
+            std::string where = filename + ":" + std::to_string(line_number);
+            std::size_t comment = line.find('#');
+            if (comment != std::string::npos) {
+                line.erase(comment);
+            }
+            std::istringstream fields(line);
+            std::string key_id, bits, positions;
+            std::size_t width = 0;
+            if (!(fields >> key_id)) {
+                continue; // blank line
+            }
+            if (!(fields >> width >> bits)) {
+                throw std::runtime_error(where + ": expected <key-id> <width> <key-bits> [<positions>]");
+            }
+            fields >> positions;
+            std::string extra;
+            if (fields >> extra) {
+                throw std::runtime_error(where + ": unexpected '" + extra + "' after the mutation positions (list them without spaces)");
+            }
+            if (key_id.size() > MAX_KEY_ID_LENGTH) {
+                throw std::runtime_error(where + ": key ID longer than " + std::to_string(MAX_KEY_ID_LENGTH) + " characters");
+            }
+            KeyDefinition definition{width, bits, {}};
+            std::istringstream list(positions);
+            for (std::string position; std::getline(list, position, ',');) {
+                if (position.empty() || position.find_first_not_of("0123456789") != std::string::npos) {
+                    throw std::runtime_error(where + ": bad mutation position '" + position + "'");
+                }
+                definition.mutation_positions.push_back(std::stoul(position));
+            }
+            if (!definitions_.emplace(key_id, definition).second) {
+                throw std::runtime_error(where + ": duplicate key ID " + key_id);
+            }
+        }
+    }
+
+    KeyRing(const KeyRing &) = delete;
+    KeyRing &operator=(const KeyRing &) = delete;
+
+    // Function to return the compiled schedule of `key_id`, compiling and caching it on first use;
+    // the reference stays valid for the life of the ring
+    const KeySchedule &schedule(const std::string &key_id) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto cached = schedules_.find(key_id);
+        if (cached != schedules_.end()) {
+            return *cached->second;
+        }
+        auto definition = definitions_.find(key_id);
+        if (definition == definitions_.end()) {
+            throw std::runtime_error("Unknown key ID: " + key_id);
+        }
+        const KeyDefinition &key = definition->second;
+        std::unique_ptr<KeySchedule> compiled(new KeySchedule(key_id, key.width, key.bits, key.mutation_positions));
+        return *schedules_.emplace(key_id, std::move(compiled)).first->second;
+    }
+
+private:
+    struct KeyDefinition {
+        std::size_t width;
+        std::string bits;
+        std::vector<std::size_t> mutation_positions;
+    };
+
+    std::unordered_map<std::string, KeyDefinition> definitions_;
+    std::unordered_map<std::string, std::unique_ptr<KeySchedule>> schedules_;
+    std::mutex mtx_;
+};
+
+} // namespace xec
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Memory-mapped file for the zero-copy I/O backend (--io mmap).
+//
+// The cipher kernel reads plaintext/ciphertext straight from the page cache and writes
+// into a pre-sized shared mapping of the output file, so no user-space buffer sits
+// between disk and cipher. Both mappings are advised MADV_SEQUENTIAL for readahead.
+namespace xec {
+
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    // Function to map an existing file read-only
+    static MappedFile open_read(const std::string &filename) {
+        MappedFile file;
+        file.fd_ = ::open(filename.c_str(), O_RDONLY);
+        if (file.fd_ < 0) {
+            throw std::runtime_error("Cannot open file: " + filename + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (::fstat(file.fd_, &st) != 0) {
+            throw std::runtime_error("Cannot stat file: " + filename + ": " + std::strerror(errno));
+        }
+        file.map(static_cast<std::size_t>(st.st_size), PROT_READ, filename);
+        return file;
+    }
+
+    // Function to create (or truncate) a file of exactly `size` bytes and map it read-write
+    static MappedFile create(const std::string &filename, std::size_t size) {
+        MappedFile file;
+        file.fd_ = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (file.fd_ < 0) {
+            throw std::runtime_error("Cannot open output file: " + filename + ": " + std::strerror(errno));
+        }
+        if (::ftruncate(file.fd_, static_cast<off_t>(size)) != 0) {
+            throw std::runtime_error("Cannot size output file: " + filename + ": " + std::strerror(errno));
+        }
+        file.map(size, PROT_READ | PROT_WRITE, filename);
+        return file;
+    }
+
+    // Function to map an existing file read-write after resizing it to exactly `size` bytes, for
+    // patching it in place
+    static MappedFile open_update(const std::string &filename, std::size_t size) {
+        MappedFile file;
+        file.fd_ = ::open(filename.c_str(), O_RDWR);
+        if (file.fd_ < 0) {
+            throw std::runtime_error("Cannot open output file: " + filename + ": " + std::strerror(errno));
+        }
+        if (::ftruncate(file.fd_, static_cast<off_t>(size)) != 0) {
+            throw std::runtime_error("Cannot size output file: " + filename + ": " + std::strerror(errno));
+        }
+        file.map(size, PROT_READ | PROT_WRITE, filename);
+        return file;
+    }
+
+    MappedFile(MappedFile &&other) noexcept { swap(other); }
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            release();
+            swap(other);
+        }
+        return *this;
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() { release(); }
+
+    uint8_t *data() { return data_; }
+    const uint8_t *data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    void map(std::size_t size, int prot, const std::string &filename) {
+        size_ = size;
+        if (size == 0) {
+            return; // mmap rejects empty mappings; an empty file has nothing to process
+        }
+        void *addr = ::mmap(nullptr, size, prot, MAP_SHARED, fd_, 0);
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("Cannot map file: " + filename + ": " + std::strerror(errno));
+        }
+        data_ = static_cast<uint8_t *>(addr);
+        ::madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+
+    void release() {
+        if (data_) {
+            ::munmap(data_, size_);
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+        fd_ = -1;
+    }
+
+    void swap(MappedFile &other) noexcept {
+        std::swap(fd_, other.fd_);
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+    }
+
+    int fd_ = -1;
+    uint8_t *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+} // namespace xec
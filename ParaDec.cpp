@@ -1,116 +1,192 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <bitset>
 #include <chrono>
 #include <iomanip>
 #include <string>
-#include <thread>
-#include <mutex>
-
-// Key for encryption and decryption
-std::bitset<256> key("110100101101111010010111101010111000110011001011110110001111010000111001010011111100110100101100100110100011100101011110110101011011001001100010111010110011111010001001110100100010010011000101100110101010011011000111101001100100010110111110110001011001101");
-
-// Function to reverse mutation on a 256-bit segment
-void reverse_mutate(std::bitset<256> &segment) {
-    std::vector<size_t> bits_to_flip = {50, 100, 150}; // Original mutation positions
-    for (size_t bit : bits_to_flip) {
-        if (bit < segment.size()) {
-            segment.flip(bit);
+#include <cstring>
+#include <memory>
+#include "CipherContainer.h"
+#include "ChunkChecksum.h"
+#include "ChunkCompression.h"
+#include "ChunkEngine.h"
+#include "SegmentCipher.h"
+#include "ChunkRing.h"
+#include "MappedFile.h"
+#include "StageTimer.h"
+#include "CipherStats.h"
+#include "KeySchedule.h"
+#include "TuneProfile.h"
+
+// Decryption applies the same mask as the encryptor that wrote the container: XecCipher256 for
+// ParaEn output, XecCipher128 for XecLDS_SDS output, or the key file key named in the header.
+// Every decrypt path (below and in ChunkEngine.h) takes the cipher as an object, so it runs with
+// either the compile-time ciphers or a runtime KeySchedule.
+//
+// Function to call `run` with the cipher matching the container's key ID and segment width
+template <typename Run>
+void with_container_cipher(const std::string &encrypted_filename, xec::KeyRing *keys, Run run) {
+    xec::ContainerHeader header = xec::ContainerReader("output/" + encrypted_filename).header();
+    std::string key_id = xec::container_key_id(header);
+    if (!key_id.empty()) {
+        if (!keys) {
+            throw std::runtime_error(encrypted_filename + " was encrypted with key " + key_id + "; pass --key-file");
         }
+        const xec::KeySchedule &schedule = keys->schedule(key_id);
+        if (schedule.width != header.segment_bits) {
+            throw std::runtime_error("Key " + key_id + " is " + std::to_string(schedule.width) + "-bit, container has " +
+                                     std::to_string(header.segment_bits) + "-bit segments");
+        }
+        run(schedule);
+    } else if (header.segment_bits == xec::XecCipher256::width) {
+        run(xec::XecCipher256());
+    } else if (header.segment_bits == xec::XecCipher128::width) {
+        run(xec::XecCipher128());
+    } else {
+        throw std::runtime_error("No cipher for " + std::to_string(header.segment_bits) + "-bit segments in " + encrypted_filename);
     }
 }
 
-// Function to reverse crossover (XOR with key)
-void reverse_crossover(std::bitset<256> &segment) {
-    segment ^= key; // XOR with key again to revert
-}
-
-// Function to decrypt a binary chunk by reversing encryption steps
-std::string decrypt_chunk(const std::string &binary_chunk) {
-    std::vector<std::bitset<256>> segments;
-    size_t segment_count = binary_chunk.size() / 256;
-
-    for (size_t i = 0; i < segment_count; ++i) {
-        std::bitset<256> segment(binary_chunk.substr(i * 256, 256));
-
-        // Reverse mutation and crossover
-        reverse_mutate(segment);
-        reverse_crossover(segment);
-
-        segments.push_back(segment);
-    }
-
-    std::string decrypted_chunk;
-    for (const auto &segment : segments) {
-        decrypted_chunk += segment.to_string();
+// Function to compute the plaintext throughput of each NUMA node's workers over `elapsed_s`
+std::vector<double> node_rates(const xec::CipherStats &stats, double elapsed_s) {
+    std::vector<double> rates;
+    for (const xec::CipherTotals &node : stats.node_totals()) {
+        rates.push_back(node.bytes / elapsed_s);
     }
-
-    return decrypted_chunk;
+    return rates;
 }
 
-// Thread-safe decryption of each chunk and appending to the output
-void process_chunk(const std::string &binary_chunk, std::string &output, std::mutex &mtx) {
-    std::string decrypted_chunk = decrypt_chunk(binary_chunk);
-
-    std::lock_guard<std::mutex> lock(mtx);
-    output += decrypted_chunk;
-}
-
-// Function to read an encrypted file in chunks, decrypt using threading, and measure decryption time
-void decrypt_file_in_chunks(const std::string &encrypted_filename, const std::string &decrypted_filename,
-                            double &decryption_time_s, double &throughput, std::size_t chunk_size = 1024) {
-    std::ifstream encrypted_file("output/" + encrypted_filename);
-    std::ofstream decrypted_file("plaintext/" + decrypted_filename);
-    if (!encrypted_file || !decrypted_file) {
-        throw std::runtime_error("Cannot open encrypted or decrypted file.");
-    }
-
-    std::vector<std::thread> threads;
-    std::mutex mtx;
-    std::string decrypted_output;
-    std::string binary_chunk;
-    binary_chunk.reserve(chunk_size);
-
+// Function to decrypt only plaintext bytes [offset, offset + length) of an encrypted file via the chunk index
+template <typename Cipher>
+void decrypt_file_range(const Cipher &cipher, const std::string &encrypted_filename, const std::string &decrypted_filename, uint64_t offset, uint64_t length,
+                        double &decryption_time_s, double &throughput) {
     auto start = std::chrono::high_resolution_clock::now();
 
-    // Read file in chunks and process each chunk in a separate thread
-    while (std::getline(encrypted_file, binary_chunk)) {
-        threads.emplace_back(process_chunk, binary_chunk, std::ref(decrypted_output), std::ref(mtx));
-        if (threads.size() >= std::thread::hardware_concurrency()) {
-            for (auto &t : threads) {
-                t.join();
-            }
-            threads.clear();
-        }
+    xec::ContainerReader reader("output/" + encrypted_filename);
+    std::string plaintext;
+    if (reader.compressed()) {
+        xec::ChunkCodec codec(0);
+        xec::decrypt_compressed_range(reader, offset, length, plaintext, cipher, codec);
+    } else {
+        xec::decrypt_range(reader, offset, length, plaintext, cipher);
     }
 
-    // Wait for remaining threads to finish
-    for (auto &t : threads) {
-        t.join();
+    std::ofstream decrypted_file("plaintext/" + decrypted_filename, std::ios::binary);
+    if (!decrypted_file) {
+        throw std::runtime_error("Cannot open decrypted file.");
     }
+    decrypted_file.write(plaintext.data(), plaintext.size());
 
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> duration = end - start;
     decryption_time_s = duration.count();
 
-    decrypted_file << decrypted_output;
-
-    // Calculate throughput as (file size in bytes / decryption time)
-    encrypted_file.clear();
-    encrypted_file.seekg(0, std::ios::end);
-    double file_size_bytes = encrypted_file.tellg();
-    throughput = file_size_bytes / decryption_time_s;
+    // Throughput of a range read is measured over the bytes requested
+    throughput = length / decryption_time_s;
 }
 
 // Main function to decrypt each file in the list of datasets and calculate metrics
-int main() {
-    std::vector<std::string> encrypted_datasets = {
-        "encrypted_D1.txt", "encrypted_D2.txt", "encrypted_D3.txt",
-        "encrypted_D4.txt", "encrypted_D5.txt", "encrypted_D6.txt",
+int main(int argc, char *argv[]) {
+    // --threads N sets the worker pool size (default: one per hardware thread)
+    // --in-flight N caps the chunks resident in the pipeline (default: two per worker)
+    // --io stream|mmap selects the streaming pipeline or the zero-copy mapped backend
+    // --range OFFSET LENGTH decrypts only those plaintext bytes of each file (to decrypted_<stem>_range.txt)
+    // --prefix NAME decrypts output/<NAME>D1.xec ... (default encrypted_; encrypted128_ for XecLDS_SDS
+    //   output); the segment width is taken from each container, results go to decrypted<rest>.txt
+    // --key-file FILE supplies the keys of containers encrypted with ParaEn --key-id
+    // --numa pins each worker to a core, spreads the workers over the NUMA nodes and keeps every
+    //   chunk's buffers and cipher work on one node; per-node throughput follows each file
+    // --timers-json FILE / --timers-prom FILE export per-stage latency histograms (JSON /
+    //   Prometheus text format); build with -DXEC_ENABLE_TIMERS to record them
+    // --profile FILE takes the threads, in-flight depth and I/O backend from a Bench --tune profile
+    //   (default: xec.tune when present, see TuneProfile.h; uring decrypts with the stream backend)
+    xec::TuneProfile profile;
+    try {
+        profile = xec::load_startup_profile(argc, argv);
+    } catch (const std::exception &e) {
+        std::cerr << "Error loading profile: " << e.what() << std::endl;
+        return 1;
+    }
+    std::size_t worker_count = profile.threads;
+    std::string input_prefix = "encrypted_";
+    std::string key_file;
+    std::string timers_json, timers_prom;
+    bool mapped_io = profile.io == "mmap";
+    bool numa = false;
+    std::size_t in_flight = profile.in_flight;
+    bool range_mode = false;
+    uint64_t range_offset = 0, range_length = 0;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                worker_count = xec::parse_count("--threads", argv[++i]);
+            } else if (std::strcmp(argv[i], "--numa") == 0) {
+                numa = true;
+            } else if (std::strcmp(argv[i], "--in-flight") == 0 && i + 1 < argc) {
+                in_flight = xec::parse_count("--in-flight", argv[++i]);
+            } else if (std::strcmp(argv[i], "--timers-json") == 0 && i + 1 < argc) {
+                timers_json = argv[++i];
+            } else if (std::strcmp(argv[i], "--timers-prom") == 0 && i + 1 < argc) {
+                timers_prom = argv[++i];
+            } else if (std::strcmp(argv[i], "--key-file") == 0 && i + 1 < argc) {
+                key_file = argv[++i];
+            } else if (std::strcmp(argv[i], "--prefix") == 0 && i + 1 < argc) {
+                input_prefix = argv[++i];
+            } else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+                ++i; // loaded above
+            } else if (std::strcmp(argv[i], "--io") == 0 && i + 1 < argc) {
+                mapped_io = std::strcmp(argv[++i], "mmap") == 0;
+            } else if (std::strcmp(argv[i], "--range") == 0 && i + 2 < argc) {
+                range_mode = true;
+                range_offset = xec::parse_count("--range", argv[++i]);
+                range_length = xec::parse_count("--range", argv[++i]);
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    if (!profile.source.empty()) {
+        std::cerr << "Using profile " << profile.source << std::endl;
+    }
+    // Keys are compiled on first use and shared by every file that names them
+    std::unique_ptr<xec::KeyRing> keys;
+    if (!key_file.empty()) {
+        try {
+            keys.reset(new xec::KeyRing(key_file));
+        } catch (const std::exception &e) {
+            std::cerr << "Error loading key file: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    xec::CpuTopology topology;
+    if (numa) {
+        try {
+            topology = xec::CpuTopology::detect();
+        } catch (const std::exception &e) {
+            std::cerr << "Error reading CPU topology: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    // Pinning a worker fails when its CPU is outside this process's affinity mask
+    std::unique_ptr<xec::WorkerPool> pool_owner;
+    try {
+        pool_owner.reset(new xec::WorkerPool(worker_count, numa ? &topology : nullptr));
+    } catch (const std::exception &e) {
+        std::cerr << "Error starting worker pool: " << e.what() << std::endl;
+        return 1;
+    }
+    xec::WorkerPool &pool = *pool_owner;
+    if (in_flight == 0) {
+        in_flight = 2 * pool.size();
+    }
+
+    std::vector<std::string> datasets = {
+        "D1", "D2", "D3",
+        "D4", "D5", "D6",
 
-        "encrypted_D7.txt", "encrypted_D8.txt", "encrypted_D9.txt",
-        "encrypted_D10.txt", "encrypted_D11.txt", "encrypted_D12.txt"
+        "D7", "D8", "D9",
+        "D10", "D11", "D12"
 
 
     };
@@ -119,21 +195,53 @@ int main() {
               << std::setw(20) << "Decryption Time (s)"
               << std::setw(25) << "Throughput (Bytes/sec)" << std::endl;
 
-    for (const auto &encrypted_filename : encrypted_datasets) {
+    for (const auto &dataset : datasets) {
+        std::string encrypted_filename = input_prefix + dataset + ".xec";
         try {
-            std::string decrypted_filename = "decrypted_" + encrypted_filename.substr(encrypted_filename.find_last_of("_") + 1);
+            // encrypted_D4.xec -> decrypted_D4.txt, encrypted128_D4.xec -> decrypted128_D4.txt
+            std::string stem = input_prefix + dataset;
+            if (stem.compare(0, 9, "encrypted") == 0) {
+                stem = "decrypted" + stem.substr(9);
+            }
+            std::string decrypted_filename = stem + ".txt";
             double decryption_time_s = 0.0, throughput = 0.0;
-            decrypt_file_in_chunks(encrypted_filename, decrypted_filename, decryption_time_s, throughput);
+            std::vector<double> node_throughput;
+            with_container_cipher(encrypted_filename, keys.get(), [&](const auto &cipher) {
+                if (range_mode) {
+                    decrypt_file_range(cipher, encrypted_filename, stem + "_range.txt", range_offset, range_length, decryption_time_s, throughput);
+                    return;
+                }
+                xec::CipherStats stats(&pool);
+                auto start = std::chrono::high_resolution_clock::now();
+                if (mapped_io) {
+                    xec::decrypt_file_mapped(cipher, "output/" + encrypted_filename, "plaintext/" + decrypted_filename, &pool, stats);
+                } else {
+                    xec::decrypt_file_in_chunks(cipher, "output/" + encrypted_filename, "plaintext/" + decrypted_filename, &pool, in_flight, stats);
+                }
+                std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - start;
+                decryption_time_s = duration.count();
+
+                // Calculate throughput as (plaintext bytes produced / decryption time)
+                throughput = stats.totals().bytes / decryption_time_s;
+                node_throughput = node_rates(stats, decryption_time_s);
+            });
 
             std::cout << std::setw(15) << encrypted_filename 
                       << std::fixed << std::setprecision(6) << std::setw(20) << decryption_time_s
                       << std::setw(25) << throughput << std::endl;
+            if (numa) {
+                for (std::size_t node = 0; node < node_throughput.size(); ++node) {
+                    std::cout << std::setw(15) << ("node " + std::to_string(node)) << std::setw(20) << ""
+                              << std::setw(25) << node_throughput[node] << std::endl;
+                }
+            }
 
         } catch (const std::exception &e) {
             std::cerr << "Error decrypting " << encrypted_filename << ": " << e.what() << std::endl;
         }
     }
 
+    xec::export_stage_timers(timers_json, timers_prom);
     return 0;
 }
 
@@ -1,13 +1,30 @@
 #include <iostream> 
 #include <fstream>
 #include <vector>
-#include <thread>
-#include <sstream>
-#include <bitset>
 #include <mutex>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <filesystem>
 #include <random>
 #include <chrono>
 #include <iomanip> // For tabular formatting
+#include <cstring>
+#include "CipherContainer.h"
+#include "SegmentCipher.h"
+#include "ChunkRing.h"
+#include "MappedFile.h"
+#include "UringIO.h"
+#include "StageTimer.h"
+#include "CipherStats.h"
+#include "KeySchedule.h"
+#include "ChunkManifest.h"
+#include "ChunkChecksum.h"
+#include "ChunkCompression.h"
+#include "ChunkEngine.h"
+#include "TuneProfile.h"
 
 // Function to get the size of the file in bytes
 std::streampos getFileSize(const std::string& filename) {
@@ -15,138 +32,377 @@ std::streampos getFileSize(const std::string& filename) {
     return in.tellg();
 }
 
-// Function to convert a text chunk to binary
-void text_to_binary(const std::string &chunk, std::string &binary_result) {
-    std::stringstream binary_stream;
-    for (char ch : chunk) {
-        binary_stream << std::bitset<8>(ch);
-    }
-    binary_result = binary_stream.str();
+// Function to name a dataset's outputs: its file name without the directory or extension
+std::string output_stem(const std::string &filename) {
+    std::string base_name = filename.substr(filename.find_last_of("/") + 1);
+    return base_name.substr(0, base_name.find_last_of("."));
 }
 
-// Function to apply two-point crossover between 256-bit segments
-void single_point_crossover(std::bitset<256> &segment) {
-    std::bitset<256> key("110100101101111010010111101010111000110011001011110110001111010000111001010011111100110100101100100110100011100101011110110101011011001001100010111010110011111010001001110100100010010011000101100110101010011011000111101001100100010110111110110001011001101");
-    segment ^= key;
-}
- 
-// Function to apply mutation on a 256-bit segment (flip one bit)
-void mutate(std::bitset<256> &segment) {
-    std::vector<size_t> bits_to_flip = {50, 100, 150}; // Example positions
-    for (size_t bit : bits_to_flip) {
-        if (bit < segment.size()) {  // Ensure bit index is within bounds
-            segment.flip(bit);
-        }
-    }
-}
-
-// Function to calculate Hamming distance (count number of differing bits)
-size_t hamming_distance(const std::bitset<256> &a, const std::bitset<256> &b) {
-    return (a ^ b).count(); // XOR the two bitsets and count the number of 1s (differing bits)
-}
+// Built-in 256-bit cipher shared with ParaDec and XEC_Dec_LDS (key XOR, flips at bits 50/100/150); crossover and
+// mutation are folded into one compile-time mask. --key-file/--key-id swap in a runtime key compiled the same way.
+using Cipher = xec::XecCipher256;
 
-// Function to convert a 1024-bit chunk (as a string) into multiple 256-bit segments
-std::vector<std::bitset<256>> convert_chunk_to_segments(const std::string &chunk) {
-    std::vector<std::bitset<256>> segments;
-    size_t segment_count = chunk.size() / 256;
-    for (size_t i = 0; i < segment_count; ++i) {
-        std::bitset<256> segment(chunk.substr(i * 256, 256));
-        segments.push_back(segment);
+// Function to print the throughput of each NUMA node's workers over one file's run
+void print_node_throughput(const xec::CipherStats &stats, double elapsed_s) {
+    std::vector<xec::CipherTotals> nodes = stats.node_totals();
+    for (std::size_t node = 0; node < nodes.size(); ++node) {
+        std::cout << std::setw(15) << ("node " + std::to_string(node))
+                  << std::setw(105) << ""
+                  << std::setw(30) << std::fixed << std::setprecision(2) << nodes[node].bytes / elapsed_s
+                  << "\n";
     }
-    return segments;
 }
 
-// Function to convert multiple 256-bit segments to a 1024-bit chunk
-std::string convert_segments_to_chunk(const std::vector<std::bitset<256>> &segments) {
-    std::string chunk;
-    for (const auto &segment : segments) {
-        chunk += segment.to_string();
-    }
-    return chunk;
+// Function to compute plaintext bytes per stored payload byte (1 for an empty file)
+double compression_ratio(uint64_t plaintext_bytes, uint64_t payload_bytes) {
+    return payload_bytes ? static_cast<double>(plaintext_bytes) / payload_bytes : 1.0;
 }
 
-// Function to read file in chunks using threading and calculate Avalanche Effect
-void read_file_in_chunks(const std::string &filename, std::size_t chunk_size, std::vector<std::string> &output_list, std::mutex &mtx, double &total_avalanche_effect, size_t &total_bits_processed) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) {
-        throw std::runtime_error("Cannot open file: " + filename);
-    }
+// One file of a job batch and its outcome
+struct FileJob {
+    std::string input_filename;
+    uint64_t size = 0;
+    double encryption_time_s = 0.0;
+    double avalanche_effect = 0.0;
+    uint64_t payload_bytes = 0;   // ciphertext payload bytes written (after compression)
+    std::string error;
+};
 
-    std::vector<std::thread> threads;
-    std::string chunk;
-    size_t index = 0;
-    double local_avalanche_effect = 0.0;
-    size_t processed_segments = 0;
-
-    std::streampos fileSize = getFileSize(filename);
-    double fileSizeMB = static_cast<double>(fileSize) / (1024 * 1024);
-
-    while (file.good()) {
-        chunk.resize(chunk_size);
-        file.read(&chunk[0], chunk_size);
-        chunk.resize(file.gcount());
-
-        if (chunk.empty()) {
-            break;
+// Function to list the files of a job: every regular file of a directory, or one path per
+// line of a manifest file (blank lines and lines starting with '#' are skipped). Outputs are
+// named by file stem, so two files with the same stem are rejected rather than racing on one container.
+std::vector<FileJob> load_jobs(const std::string &path) {
+    std::vector<FileJob> jobs;
+    if (std::filesystem::is_directory(path)) {
+        for (const auto &entry : std::filesystem::directory_iterator(path)) {
+            if (entry.is_regular_file()) {
+                jobs.emplace_back();
+                jobs.back().input_filename = entry.path().string();
+            }
         }
-
-        {
-            std::lock_guard<std::mutex> lock(mtx);
-            output_list.push_back(""); // Placeholder for the binary result
+    } else {
+        std::ifstream manifest(path);
+        if (!manifest) {
+            throw std::runtime_error("Cannot open job manifest: " + path);
         }
+        std::string line;
+        while (std::getline(manifest, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty() && line[0] != '#') {
+                jobs.emplace_back();
+                jobs.back().input_filename = line;
+            }
+        }
+    }
+    std::map<std::string, std::string> stems;
+    for (const auto &job : jobs) {
+        auto inserted = stems.emplace(output_stem(job.input_filename), job.input_filename);
+        if (!inserted.second) {
+            throw std::runtime_error(inserted.first->second + " and " + job.input_filename + " would both write output/encrypted_" +
+                                     inserted.first->first + ".xec");
+        }
+    }
+    for (auto &job : jobs) {
+        XEC_TIME_STAGE(xec::Stage::FileSize);
+        job.size = static_cast<uint64_t>(std::max<std::streamoff>(getFileSize(job.input_filename), 0));
+    }
+    // Largest first, so big files start early and small ones fill the gaps at the end
+    std::stable_sort(jobs.begin(), jobs.end(), [](const FileJob &a, const FileJob &b) { return a.size > b.size; });
+    return jobs;
+}
 
-        threads.emplace_back([chunk, &output_list, &mtx, index, &local_avalanche_effect, &processed_segments, &total_bits_processed]() mutable {
-            std::string binary_result;
-            text_to_binary(chunk, binary_result);
-            auto segments = convert_chunk_to_segments(binary_result);
-
-            for (size_t i = 0; i < segments.size(); i++) {
-                std::bitset<256> original_segment = segments[i];
-
-                single_point_crossover(segments[i]);
-                mutate(segments[i]);
+// Function to encrypt every job file with the chunk tasks of up to `file_concurrency` files
+// interleaved on the shared pool; `budget` caps their combined chunk data in flight (mapped files
+// hold no chunk buffers). Backend and text export are the same as for single files.
+void run_jobs(const xec::KeySchedule &cipher, std::vector<FileJob> &jobs, std::size_t chunk_size, xec::WorkerPool &pool, std::size_t in_flight,
+              std::size_t file_concurrency, xec::MemoryBudget &budget, bool text_export, bool mapped_io, bool uring_io, int compress_level) {
+    std::atomic<std::size_t> next_job(0);
+    std::atomic<std::size_t> completed(0);
+    std::mutex progress_mtx;
 
-                size_t flipped_bits = hamming_distance(original_segment, segments[i]);
-                local_avalanche_effect += flipped_bits;
+    auto drive = [&]() {
+        for (std::size_t index = next_job++; index < jobs.size(); index = next_job++) {
+            FileJob &job = jobs[index];
+            std::string stem = output_stem(job.input_filename);
+            std::size_t file_chunks = static_cast<std::size_t>((job.size + chunk_size - 1) / chunk_size);
+            xec::CipherStats stats(&pool);
 
-                processed_segments++;
-                total_bits_processed += 256;
+            auto start_time = std::chrono::high_resolution_clock::now();
+            try {
+                xec::discard_manifest("output/encrypted_" + stem + ".xec");
+                if (mapped_io) {
+                    xec::encrypt_file_mapped(cipher, job.input_filename, "output/encrypted_" + stem + ".xec", chunk_size, &pool, stats);
+                } else {
+                    xec::encrypt_file_in_chunks(cipher, job.input_filename, "output/encrypted_" + stem + ".xec",
+                                                text_export ? "output/encrypted_" + stem + ".txt" : "", chunk_size, &pool,
+                                                std::max<std::size_t>(1, std::min(in_flight, file_chunks)), uring_io, &budget, stats, compress_level);
+                }
+            } catch (const std::exception &e) {
+                job.error = e.what();
             }
+            auto end_time = std::chrono::high_resolution_clock::now();
+            job.encryption_time_s = std::chrono::duration<double>(end_time - start_time).count();
+            job.avalanche_effect = stats.totals().avalanche_effect();
+            job.payload_bytes = stats.totals().segments * cipher.segment_bytes;
 
-            binary_result = convert_segments_to_chunk(segments);
-            {
-                std::lock_guard<std::mutex> lock(mtx);
-                output_list[index] = binary_result;
-            }
-        });
+            std::lock_guard<std::mutex> lock(progress_mtx);
+            std::cerr << "Completed " << ++completed << "/" << jobs.size() << ": " << job.input_filename
+                      << (job.error.empty() ? "" : " (failed)") << std::endl;
+        }
+    };
 
-        index++;
+    std::vector<std::thread> drivers;
+    for (std::size_t i = 0; i < std::min(file_concurrency, jobs.size()); ++i) {
+        drivers.emplace_back(drive);
     }
-
-    for (auto &thread : threads) {
-        thread.join();
+    for (auto &driver : drivers) {
+        driver.join();
     }
+}
 
-    std::lock_guard<std::mutex> lock(mtx);
-    if (processed_segments > 0) {
-        total_avalanche_effect += local_avalanche_effect;
+// Function to print the per-file results of a job batch plus the aggregate throughput; with
+// `compressed` a ratio column (plaintext / payload bytes) follows, and throughput counts plaintext bytes
+void print_job_results(const std::vector<FileJob> &jobs, double wall_time_s, bool compressed) {
+    std::cout << std::setw(40) << "Dataset"
+              << std::setw(18) << "Size (Bytes)"
+              << std::setw(25) << "Encryption Time (s)"
+              << std::setw(30) << "Average Avalanche Effect (%)"
+              << std::setw(30) << (compressed ? "Effective Throughput (B/s)" : "Throughput (Bytes/sec)");
+    if (compressed) {
+        std::cout << std::setw(20) << "Compression Ratio";
+    }
+    std::cout << "\n";
+    uint64_t total_bytes = 0;
+    uint64_t total_payload = 0;
+    std::size_t failed = 0;
+    for (const auto &job : jobs) {
+        if (!job.error.empty()) {
+            ++failed;
+            std::cerr << "Error processing " << job.input_filename << ": " << job.error << std::endl;
+            continue;
+        }
+        total_bytes += job.size;
+        total_payload += job.payload_bytes;
+        std::cout << std::setw(40) << job.input_filename
+                  << std::setw(18) << job.size
+                  << std::setw(25) << std::fixed << std::setprecision(6) << job.encryption_time_s
+                  << std::setw(30) << std::fixed << std::setprecision(4) << job.avalanche_effect
+                  << std::setw(30) << std::fixed << std::setprecision(2) << job.size / job.encryption_time_s;
+        if (compressed) {
+            std::cout << std::setw(20) << std::fixed << std::setprecision(3) << compression_ratio(job.size, job.payload_bytes);
+        }
+        std::cout << "\n";
+    }
+    std::cout << std::setw(40) << ("TOTAL (" + std::to_string(jobs.size() - failed) + " files, " + std::to_string(failed) + " failed)")
+              << std::setw(18) << total_bytes
+              << std::setw(25) << std::fixed << std::setprecision(6) << wall_time_s
+              << std::setw(30) << ""
+              << std::setw(30) << std::fixed << std::setprecision(2) << total_bytes / wall_time_s;
+    if (compressed) {
+        std::cout << std::setw(20) << std::fixed << std::setprecision(3) << compression_ratio(total_bytes, total_payload);
     }
+    std::cout << "\n";
 }
 
-// Function to write binary data to a text file in the 'output' folder
-void write_binary_to_file(const std::string &output_filename, const std::vector<std::string> &binary_output) {
-    std::ofstream outfile("output/" + output_filename);
-    if (!outfile) {
-        throw std::runtime_error("Cannot open output file");
+// Main function with modified output formatting
+int main(int argc, char *argv[]) {
+    // --text-export additionally writes the legacy '0'/'1' text ciphertext for debugging
+    // --threads N sets the worker pool size (default: one per hardware thread)
+    // --in-flight N caps the chunks resident in the pipeline (default: two per worker)
+    // --io stream|mmap|uring selects buffered streams, the zero-copy mapped backend (no text export)
+    //   or io_uring reads/writes (needs a build with -DXEC_HAVE_LIBURING -luring)
+    // --jobs PATH encrypts every file of a directory or manifest (one path per line) with chunks
+    //   from up to --file-concurrency N files (default: one per worker) sharing the pool and
+    //   at most --max-memory BYTES (default 256 MB) of chunk data in flight
+    // --timers-json FILE / --timers-prom FILE export per-stage latency histograms (JSON /
+    //   Prometheus text format); build with -DXEC_ENABLE_TIMERS to record them
+    // --key-file FILE --key-id ID encrypts with that key of the key file (see KeySchedule.h)
+    //   instead of the built-in 256-bit key; the ID is recorded in each container
+    // --incremental re-encrypts only the chunks that changed since the last run, patching the
+    //   container in place (see ChunkManifest.h); the first run writes the manifest
+    // --numa pins each worker to a core, spreads the workers over the NUMA nodes and keeps every
+    //   chunk's buffers and cipher work on one node; per-node throughput follows each file
+    // --compress LEVEL deflates each chunk at zlib level 1-9 before encrypting it (needs a build
+    //   with -DXEC_HAVE_ZLIB -lz; stream/uring backends only); the table adds the compression ratio
+    // --chunk-size BYTES sets the plaintext bytes per chunk (default 1 MB)
+    // --profile FILE takes the chunk size, threads, in-flight depth and I/O backend from a
+    //   Bench --tune profile (default: xec.tune when present, see TuneProfile.h); flags override it
+    xec::TuneProfile profile;
+    try {
+        profile = xec::load_startup_profile(argc, argv);
+    } catch (const std::exception &e) {
+        std::cerr << "Error loading profile: " << e.what() << std::endl;
+        return 1;
+    }
+    bool text_export = false;
+    std::string compress_arg;
+    bool numa = false;
+    bool incremental = false;
+    std::string key_file, key_id;
+    std::string timers_json, timers_prom;
+    std::string jobs_path;
+    std::size_t file_concurrency = 0;
+    uint64_t max_memory = 256ull << 20;
+    bool mapped_io = profile.io == "mmap";
+    bool uring_io = profile.io == "uring";
+    std::size_t worker_count = profile.threads;
+    std::size_t in_flight = profile.in_flight;
+    std::size_t chunk_size = profile.chunk_size;
+    bool io_given = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--text-export") == 0) {
+                text_export = true;
+            } else if (std::strcmp(argv[i], "--incremental") == 0) {
+                incremental = true;
+            } else if (std::strcmp(argv[i], "--numa") == 0) {
+                numa = true;
+            } else if (std::strcmp(argv[i], "--compress") == 0 && i + 1 < argc) {
+                compress_arg = argv[++i];
+            } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                worker_count = xec::parse_count("--threads", argv[++i]);
+            } else if (std::strcmp(argv[i], "--in-flight") == 0 && i + 1 < argc) {
+                in_flight = xec::parse_count("--in-flight", argv[++i]);
+            } else if (std::strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc) {
+                chunk_size = xec::parse_count("--chunk-size", argv[++i]);
+            } else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+                ++i; // loaded above
+            } else if (std::strcmp(argv[i], "--timers-json") == 0 && i + 1 < argc) {
+                timers_json = argv[++i];
+            } else if (std::strcmp(argv[i], "--timers-prom") == 0 && i + 1 < argc) {
+                timers_prom = argv[++i];
+            } else if (std::strcmp(argv[i], "--key-file") == 0 && i + 1 < argc) {
+                key_file = argv[++i];
+            } else if (std::strcmp(argv[i], "--key-id") == 0 && i + 1 < argc) {
+                key_id = argv[++i];
+            } else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+                jobs_path = argv[++i];
+            } else if (std::strcmp(argv[i], "--file-concurrency") == 0 && i + 1 < argc) {
+                file_concurrency = xec::parse_count("--file-concurrency", argv[++i]);
+            } else if (std::strcmp(argv[i], "--max-memory") == 0 && i + 1 < argc) {
+                max_memory = xec::parse_count("--max-memory", argv[++i]);
+            } else if (std::strcmp(argv[i], "--io") == 0 && i + 1 < argc) {
+                std::string io = argv[++i];
+                mapped_io = io == "mmap";
+                uring_io = io == "uring";
+                io_given = true;
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    if (incremental) {
+        // The incremental path maps the input and patches the container in place with its own I/O
+        const char *conflict = !jobs_path.empty() ? "--jobs"
+                             : text_export        ? "--text-export"
+                             : io_given && mapped_io ? "--io mmap"
+                             : io_given && uring_io  ? "--io uring"
+                                                     : nullptr;
+        if (conflict) {
+            std::cerr << "Error: --incremental patches payloads in place and cannot be combined with " << conflict << std::endl;
+            return 1;
+        }
+        if (mapped_io || uring_io) {
+            std::cerr << "--incremental uses its own I/O; ignoring the profile's io " << profile.io << std::endl;
+            mapped_io = uring_io = false;
+        }
+    }
+#ifndef XEC_HAVE_LIBURING
+    if (uring_io) {
+        std::cerr << "Built without liburing; using the stream backend" << std::endl;
+        uring_io = false;
+    }
+#endif
+    if (chunk_size == 0) {
+        std::cerr << "Error: --chunk-size must be positive" << std::endl;
+        return 1;
+    }
+    if (!profile.source.empty()) {
+        std::cerr << "Using profile " << profile.source << std::endl;
+    }
+    int compress_level = 0;
+    if (!compress_arg.empty()) {
+        try {
+            compress_level = xec::parse_compress_level(compress_arg);
+            if (incremental) {
+                throw std::runtime_error("--incremental patches payloads in place and cannot be combined with --compress");
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        if (!xec::COMPRESSION_AVAILABLE) {
+            std::cerr << "Built without zlib; writing uncompressed containers" << std::endl;
+            compress_level = 0;
+        } else if (mapped_io) {
+            // The mapped writer lays payloads out before encrypting, which needs their sizes up front
+            std::cerr << "--compress needs the stream backend; using it instead of mmap" << std::endl;
+            mapped_io = false;
+        }
+    }
+    if (text_export && mapped_io) {
+        std::cerr << "--text-export needs the stream backend; using it instead of mmap" << std::endl;
+        mapped_io = false;
+    }
+    // The key is compiled once; every file and worker shares the one schedule
+    const xec::KeySchedule builtin = xec::KeySchedule::from_cipher<Cipher>();
+    std::unique_ptr<xec::KeyRing> keys;
+    const xec::KeySchedule *selected = &builtin;
+    if (!key_file.empty() || !key_id.empty()) {
+        try {
+            if (key_file.empty() || key_id.empty()) {
+                throw std::runtime_error("--key-file and --key-id must be given together");
+            }
+            keys.reset(new xec::KeyRing(key_file));
+            selected = &keys->schedule(key_id);
+        } catch (const std::exception &e) {
+            std::cerr << "Error loading key: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    const xec::KeySchedule &cipher = *selected;
+    xec::CpuTopology topology;
+    if (numa) {
+        try {
+            topology = xec::CpuTopology::detect();
+        } catch (const std::exception &e) {
+            std::cerr << "Error reading CPU topology: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    // Pinning a worker fails when its CPU is outside this process's affinity mask
+    std::unique_ptr<xec::WorkerPool> pool_owner;
+    try {
+        pool_owner.reset(new xec::WorkerPool(worker_count, numa ? &topology : nullptr));
+    } catch (const std::exception &e) {
+        std::cerr << "Error starting worker pool: " << e.what() << std::endl;
+        return 1;
+    }
+    xec::WorkerPool &pool = *pool_owner;
+    if (in_flight == 0) {
+        in_flight = 2 * pool.size();
     }
 
-    for (const auto &binary_chunk : binary_output) {
-        outfile << binary_chunk << "\n";
+    if (!jobs_path.empty()) {
+        try {
+            std::vector<FileJob> jobs = load_jobs(jobs_path);
+            xec::MemoryBudget budget(max_memory);
+            auto start_time = std::chrono::high_resolution_clock::now();
+            run_jobs(cipher, jobs, chunk_size, pool, in_flight, file_concurrency ? file_concurrency : pool.size(), budget, text_export, mapped_io,
+                     uring_io, compress_level);
+            auto end_time = std::chrono::high_resolution_clock::now();
+            print_job_results(jobs, std::chrono::duration<double>(end_time - start_time).count(), compress_level != 0);
+        } catch (const std::exception &e) {
+            std::cerr << "Error running jobs from " << jobs_path << ": " << e.what() << std::endl;
+            return 1;
+        }
+        xec::export_stage_timers(timers_json, timers_prom);
+        return 0;
     }
-}
 
-// Main function with modified output formatting
-int main() {
     std::vector<std::string> datasets = {
                   
   // "dataset/D1.txt", 
@@ -168,31 +424,44 @@ int main() {
               << std::setw(25) << "Encryption Time (ms)"
               << std::setw(25) << "Encryption Time (μs)"
               << std::setw(30) << "Average Avalanche Effect (%)" 
-              << std::setw(30) << "Throughput (Bytes/sec)" 
-              << "\n";
+              << std::setw(30) << (compress_level ? "Effective Throughput (B/s)" : "Throughput (Bytes/sec)");
+    if (compress_level) {
+        std::cout << std::setw(20) << "Compression Ratio";
+    }
+    std::cout << "\n";
     
     for (const auto& input_filename : datasets) {
-        const std::size_t chunk_size = 1048576; // 1MB chunk size
-        std::vector<std::string> binary_output;
-        std::mutex mtx;
-        double total_flipped_bits = 0.0;
-        size_t total_bits_processed = 0;
+        xec::CipherStats stats(&pool);
 
         try {
-            std::streampos plaintext_size = getFileSize(input_filename);
+            std::streampos plaintext_size;
+            {
+                XEC_TIME_STAGE(xec::Stage::FileSize);
+                plaintext_size = getFileSize(input_filename);
+            }
             auto start_time = std::chrono::high_resolution_clock::now();
-            read_file_in_chunks(input_filename, chunk_size, binary_output, mtx, total_flipped_bits, total_bits_processed);
-            
+
             // Define a unique output filename for each dataset
-            std::string output_filename = "encrypted_" + input_filename.substr(input_filename.find_last_of("/") + 1);
-            write_binary_to_file(output_filename, binary_output);
+            std::string stem = output_stem(input_filename);
+            xec::IncrementalResult update;
+            if (incremental) {
+                update = xec::encrypt_incremental(cipher, input_filename, "output/encrypted_" + stem + ".xec", chunk_size, &pool, stats);
+            } else if (mapped_io) {
+                xec::discard_manifest("output/encrypted_" + stem + ".xec");
+                xec::encrypt_file_mapped(cipher, input_filename, "output/encrypted_" + stem + ".xec", chunk_size, &pool, stats);
+            } else {
+                xec::discard_manifest("output/encrypted_" + stem + ".xec");
+                xec::encrypt_file_in_chunks(cipher, input_filename, "output/encrypted_" + stem + ".xec",
+                                            text_export ? "output/encrypted_" + stem + ".txt" : "", chunk_size, &pool, in_flight, uring_io,
+                                            nullptr, stats, compress_level);
+            }
 
             auto end_time = std::chrono::high_resolution_clock::now();
             auto encryption_time_us = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
             auto encryption_time_ms = encryption_time_us / 1000.0;
             double encryption_time_s = encryption_time_us / 1e6;
 
-            double avalanche_effect = (total_flipped_bits / total_bits_processed) * 100.0;
+            double avalanche_effect = stats.totals().avalanche_effect();
             double throughput = plaintext_size / encryption_time_s;
 
             std::cout << std::setw(15) << input_filename
@@ -200,13 +469,24 @@ int main() {
                       << std::setw(25) << std::fixed << std::setprecision(3) << encryption_time_ms
                       << std::setw(25) << encryption_time_us
                       << std::setw(30) << std::fixed << std::setprecision(4) << avalanche_effect
-                      << std::setw(30) << std::fixed << std::setprecision(2) << throughput
-                      << "\n";
+                      << std::setw(30) << std::fixed << std::setprecision(2) << throughput;
+            if (compress_level) {
+                std::cout << std::setw(20) << std::fixed << std::setprecision(3)
+                          << compression_ratio(plaintext_size, stats.totals().segments * cipher.segment_bytes);
+            }
+            std::cout << "\n";
+            if (incremental) {
+                std::cout << std::setw(15) << "" << " re-encrypted " << update.changed_chunks << "/" << update.chunks << " chunks ("
+                          << update.changed_bytes << " bytes" << (update.rebuilt ? ", new container" : "") << ")\n";
+            }
+            if (numa) {
+                print_node_throughput(stats, encryption_time_s);
+            }
         } catch (const std::exception &e) {
             std::cerr << "Error processing " << input_filename << ": " << e.what() << std::endl;
         }
     }
 
+    xec::export_stage_timers(timers_json, timers_prom);
     return 0;
 }
-
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "SegmentKernel.h"
+
+// Compile-time-specialised segment cipher shared by every encryptor and decryptor.
+//
+// SegmentCipher<Width, Key, MutationPositions...> folds the crossover key and the
+// mutation flips into one constexpr mask, so a segment costs one XOR per word and the
+// mutation positions never reach the hot loop. XOR is its own inverse: encrypt() and
+// decrypt() apply the same mask, so the two sides are the same code and cannot drift.
+//
+// Key is a type with `static constexpr const char bits[]`, a '0'/'1' string with the most
+// significant bit first. As with std::bitset<Width>(string), only the first Width
+// characters are used and a shorter string fills the low-order bits.
+namespace xec {
+
+namespace detail {
+
+constexpr std::size_t key_length(const char *bits) {
+    std::size_t length = 0;
+    while (bits[length] != '\0') {
+        if (bits[length] != '0' && bits[length] != '1') {
+            throw std::invalid_argument("Key bits must be '0' or '1'");
+        }
+        ++length;
+    }
+    return length;
+}
+
+// Bit `bit` of a segment lives in byte (segment_bytes - 1 - bit / 8), value 1 << (bit % 8)
+constexpr void flip_mask_bit(uint8_t *bytes, std::size_t segment_bytes, std::size_t bit) {
+    bytes[segment_bytes - 1 - bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+}
+
+// Function to XOR the crossover key's `length` '0'/'1' characters into a segment mask; shared
+// by the compile-time ciphers and the runtime key schedules (KeySchedule.h)
+constexpr void apply_key_bits(uint8_t *bytes, std::size_t width, const char *bits, std::size_t length) {
+    if (length > width) {
+        length = width;
+    }
+    for (std::size_t bit = 0; bit < length; ++bit) {
+        if (bits[length - 1 - bit] == '1') {
+            flip_mask_bit(bytes, width / 8, bit);
+        }
+    }
+}
+
+template <std::size_t Width, typename Key, std::size_t... MutationPositions>
+constexpr std::array<uint8_t, Width / 8> build_mask_bytes() {
+    std::array<uint8_t, Width / 8> bytes{};
+    apply_key_bits(bytes.data(), Width, Key::bits, key_length(Key::bits));
+    (flip_mask_bit(bytes.data(), Width / 8, MutationPositions), ...);
+    return bytes;
+}
+
+} // namespace detail
+
+template <std::size_t Width, typename Key, std::size_t... MutationPositions>
+class SegmentCipher {
+public:
+    static_assert(Width == 128 || Width == 256 || Width == 512, "Segment width must be 128, 256 or 512 bits");
+    static_assert(((MutationPositions < Width) && ...), "Mutation position outside the segment");
+
+    static constexpr std::size_t width = Width;
+    static constexpr std::size_t segment_bytes = Width / 8;
+    static constexpr std::array<uint8_t, Width / 8> mask_bytes = detail::build_mask_bytes<Width, Key, MutationPositions...>();
+    static constexpr SegmentMask mask = make_segment_mask(mask_bytes.data(), Width / 8);
+
+    // Bits changed per segment, i.e. the per-segment Hamming distance plaintext -> ciphertext
+    static constexpr std::size_t flipped_bits = mask.flipped_bits;
+
+    // Function to encrypt `size` bytes starting on a segment boundary (in == out is allowed)
+    static void encrypt(const uint8_t *in, uint8_t *out, std::size_t size) { apply_segment_mask(mask, in, out, size); }
+    static void encrypt(const char *in, char *out, std::size_t size) { apply_segment_mask(mask, in, out, size); }
+
+    // Function to round a plaintext length up to whole segments
+    static constexpr std::size_t padded_size(std::size_t size) { return (size + segment_bytes - 1) / segment_bytes * segment_bytes; }
+
+    // Function to encrypt `size` plaintext bytes into padded_size(size) ciphertext bytes; a partial
+    // last segment is zero-padded first, so no plaintext byte is dropped (in == out is allowed
+    // if the buffer has room for the padding)
+    static void encrypt_padded(const uint8_t *in, uint8_t *out, std::size_t size) {
+        std::size_t whole = size / segment_bytes * segment_bytes;
+        apply_segment_mask(mask, in, out, whole);
+        if (whole < size) {
+            uint8_t tail[segment_bytes] = {};
+            std::memcpy(tail, in + whole, size - whole);
+            apply_segment_mask(mask, tail, out + whole, segment_bytes);
+        }
+    }
+    static void encrypt_padded(const char *in, char *out, std::size_t size) {
+        encrypt_padded(reinterpret_cast<const uint8_t *>(in), reinterpret_cast<uint8_t *>(out), size);
+    }
+
+    // Function to decrypt `size` bytes starting on a segment boundary (in == out is allowed).
+    // `size` need not be whole segments: decrypting a padded payload's plaintext length
+    // yields exactly the original bytes without touching the padding.
+    static void decrypt(const uint8_t *in, uint8_t *out, std::size_t size) { apply_segment_mask(mask, in, out, size); }
+    static void decrypt(const char *in, char *out, std::size_t size) { apply_segment_mask(mask, in, out, size); }
+};
+
+// 256-bit key of ParaEn / ParaDec / XEC_Dec_LDS
+struct XecKey256 {
+    static constexpr const char bits[] = "110100101101111010010111101010111000110011001011110110001111010000111001010011111100110100101100100110100011100101011110110101011011001001100010111010110011111010001001110100100010010011000101100110101010011011000111101001100100010110111110110001011001101";
+};
+
+// 128-bit key of XecLDS_SDS
+struct XecKey128 {
+    static constexpr const char bits[] = "01010000011001010110000101100011011001010010000001110111011010010111010001101000001000000110100001101111011011100110111101110010";
+};
+
+using XecCipher256 = SegmentCipher<256, XecKey256, 50, 100, 150>;
+using XecCipher128 = SegmentCipher<128, XecKey128, 50>;
+
+} // namespace xec
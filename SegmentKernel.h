@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define XEC_KERNEL_X86 1
+#endif
+
+// Word-level segment cipher kernel.
+//
+// Crossover (XOR with the key) and mutation (fixed bit flips) are both XORs with a
+// constant, so together they are one XOR with mask = mutate(crossover(0)); SegmentCipher.h
+// builds that mask. The kernel applies it to raw bytes in 64-bit words, or 256/512-bit
+// vectors when the CPU supports AVX2/AVX-512.
+//
+// Byte order matches the original text pipeline: byte 0 of a segment holds the
+// segment's most significant bits, i.e. bitset bit (Width - 8 * (byte + 1) + b).
+namespace xec {
+
+// Largest supported segment is 512 bits; the mask is replicated into one 64-byte
+// block so every vector lane lines up with a segment boundary for 128/256/512 bits
+constexpr std::size_t MASK_BLOCK_BYTES = 64;
+
+struct SegmentMask {
+    alignas(64) uint8_t block[MASK_BLOCK_BYTES];
+    std::size_t segment_bytes;
+    std::size_t flipped_bits;   // popcount of the mask, i.e. bits changed per segment
+};
+
+// Function to build a kernel mask from the bytes of one segment's combined crossover/mutation
+// mask; segment_bytes must divide MASK_BLOCK_BYTES (16, 32 or 64)
+constexpr SegmentMask make_segment_mask(const uint8_t *bytes, std::size_t segment_bytes) {
+    SegmentMask mask{};
+    mask.segment_bytes = segment_bytes;
+    mask.flipped_bits = 0;
+    for (std::size_t byte = 0; byte < segment_bytes; ++byte) {
+        for (uint8_t value = bytes[byte]; value != 0; value &= static_cast<uint8_t>(value - 1)) {
+            ++mask.flipped_bits;
+        }
+        for (std::size_t rep = byte; rep < MASK_BLOCK_BYTES; rep += segment_bytes) {
+            mask.block[rep] = bytes[byte];
+        }
+    }
+    return mask;
+}
+
+// Portable fallback: 64-bit words, then single bytes for the tail
+inline void xor_mask_scalar(const SegmentMask &mask, const uint8_t *in, uint8_t *out, std::size_t size) {
+    uint64_t words[MASK_BLOCK_BYTES / 8];
+    std::memcpy(words, mask.block, sizeof(words));
+    std::size_t pos = 0;
+    for (; pos + MASK_BLOCK_BYTES <= size; pos += MASK_BLOCK_BYTES) {
+        for (std::size_t w = 0; w < MASK_BLOCK_BYTES / 8; ++w) {
+            uint64_t value;
+            std::memcpy(&value, in + pos + w * 8, 8);
+            value ^= words[w];
+            std::memcpy(out + pos + w * 8, &value, 8);
+        }
+    }
+    for (; pos < size; ++pos) {
+        out[pos] = in[pos] ^ mask.block[pos % MASK_BLOCK_BYTES];
+    }
+}
+
+#ifdef XEC_KERNEL_X86
+__attribute__((target("avx2")))
+inline void xor_mask_avx2(const SegmentMask &mask, const uint8_t *in, uint8_t *out, std::size_t size) {
+    const __m256i lo = _mm256_load_si256(reinterpret_cast<const __m256i *>(mask.block));
+    const __m256i hi = _mm256_load_si256(reinterpret_cast<const __m256i *>(mask.block + 32));
+    std::size_t pos = 0;
+    for (; pos + MASK_BLOCK_BYTES <= size; pos += MASK_BLOCK_BYTES) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + pos));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + pos + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + pos), _mm256_xor_si256(a, lo));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + pos + 32), _mm256_xor_si256(b, hi));
+    }
+    xor_mask_scalar(mask, in + pos, out + pos, size - pos);
+}
+
+__attribute__((target("avx512f")))
+inline void xor_mask_avx512(const SegmentMask &mask, const uint8_t *in, uint8_t *out, std::size_t size) {
+    const __m512i m = _mm512_load_si512(mask.block);
+    std::size_t pos = 0;
+    for (; pos + 4 * MASK_BLOCK_BYTES <= size; pos += 4 * MASK_BLOCK_BYTES) {
+        __m512i a = _mm512_loadu_si512(in + pos);
+        __m512i b = _mm512_loadu_si512(in + pos + 64);
+        __m512i c = _mm512_loadu_si512(in + pos + 128);
+        __m512i d = _mm512_loadu_si512(in + pos + 192);
+        _mm512_storeu_si512(out + pos, _mm512_xor_si512(a, m));
+        _mm512_storeu_si512(out + pos + 64, _mm512_xor_si512(b, m));
+        _mm512_storeu_si512(out + pos + 128, _mm512_xor_si512(c, m));
+        _mm512_storeu_si512(out + pos + 192, _mm512_xor_si512(d, m));
+    }
+    for (; pos + MASK_BLOCK_BYTES <= size; pos += MASK_BLOCK_BYTES) {
+        _mm512_storeu_si512(out + pos, _mm512_xor_si512(_mm512_loadu_si512(in + pos), m));
+    }
+    xor_mask_scalar(mask, in + pos, out + pos, size - pos);
+}
+#endif
+
+using XorMaskFn = void (*)(const SegmentMask &, const uint8_t *, uint8_t *, std::size_t);
+
+struct KernelChoice {
+    XorMaskFn fn;
+    const char *name;
+};
+
+// Function to pick the widest kernel the CPU supports; XEC_KERNEL=scalar|avx2|avx512 overrides
+inline KernelChoice select_kernel() {
+    const char *forced = std::getenv("XEC_KERNEL");
+    std::string want = forced ? forced : "";
+#ifdef XEC_KERNEL_X86
+    __builtin_cpu_init();
+    bool has_avx512 = __builtin_cpu_supports("avx512f");
+    bool has_avx2 = __builtin_cpu_supports("avx2");
+    if ((want.empty() || want == "avx512") && has_avx512) {
+        return {xor_mask_avx512, "avx512"};
+    }
+    if ((want.empty() || want == "avx2" || want == "avx512") && has_avx2) {
+        return {xor_mask_avx2, "avx2"};
+    }
+#endif
+    return {xor_mask_scalar, "scalar"};
+}
+
+inline const KernelChoice &active_kernel() {
+    static const KernelChoice choice = select_kernel();
+    return choice;
+}
+
+// Function to apply the segment mask to `size` bytes starting on a segment boundary.
+// `in` and `out` may alias for in-place use.
+inline void apply_segment_mask(const SegmentMask &mask, const uint8_t *in, uint8_t *out, std::size_t size) {
+    active_kernel().fn(mask, in, out, size);
+}
+
+inline void apply_segment_mask(const SegmentMask &mask, const char *in, char *out, std::size_t size) {
+    apply_segment_mask(mask, reinterpret_cast<const uint8_t *>(in), reinterpret_cast<uint8_t *>(out), size);
+}
+
+} // namespace xec
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define XEC_TIMER_TSC 1
+#endif
+
+// Per-stage latency histograms for the encryptors and decryptors.
+//
+// Build with -DXEC_ENABLE_TIMERS to compile the timers in; otherwise XEC_TIME_STAGE expands
+// to nothing and the exports report every stage as empty. Each thread records into its own
+// histograms (power-of-two buckets of TSC ticks, or steady_clock nanoseconds off x86), which
+// only that thread writes, so recording is a few relaxed stores and never contends.
+// Histograms are merged when exported; a thread's counts are folded into a shared total when
+// it exits. TSC ticks are converted to seconds at export time from a tick/ns ratio measured
+// over the whole run.
+namespace xec {
+
+enum class Stage : std::size_t {
+    FileSize,
+    Read,
+    Cipher,
+    Write,
+    TextExport,
+    Compress,
+    Count
+};
+
+inline const char *stage_name(Stage stage) {
+    static const char *names[] = {"file_size", "read", "cipher", "write", "text_export", "compress"};
+    return names[static_cast<std::size_t>(stage)];
+}
+
+namespace timing {
+
+constexpr std::size_t STAGE_COUNT = static_cast<std::size_t>(Stage::Count);
+constexpr std::size_t BUCKET_COUNT = 64;   // bucket b counts durations in [2^b, 2^(b+1)) ticks
+
+inline uint64_t now_ticks() {
+#ifdef XEC_TIMER_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+struct StageHistogram {
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+};
+
+// Merged, non-atomic snapshot of one stage
+struct StageSnapshot {
+    std::array<uint64_t, BUCKET_COUNT> buckets{};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+};
+
+using Snapshot = std::array<StageSnapshot, STAGE_COUNT>;
+
+// Only the owning thread writes its histograms: load + store instead of a locked add
+inline void bump(std::atomic<uint64_t> &value, uint64_t by) {
+    value.store(value.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+struct ThreadHistograms;
+
+class Registry {
+public:
+    static Registry &instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    void add(ThreadHistograms *thread) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        threads_.push_back(thread);
+    }
+
+    void retire(ThreadHistograms *thread);
+    Snapshot snapshot();
+
+    // Ticks per nanosecond over the run so far (1 when ticks already are nanoseconds)
+    double ticks_per_ns() const {
+#ifdef XEC_TIMER_TSC
+        double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time_).count();
+        uint64_t elapsed_ticks = now_ticks() - start_ticks_;
+        return elapsed_ns > 0 && elapsed_ticks > 0 ? elapsed_ticks / elapsed_ns : 1.0;
+#else
+        return 1.0;
+#endif
+    }
+
+private:
+    Registry() : start_time_(std::chrono::steady_clock::now()), start_ticks_(now_ticks()) {}
+
+    static void merge(const std::array<StageHistogram, STAGE_COUNT> &from, Snapshot &into) {
+        for (std::size_t s = 0; s < STAGE_COUNT; ++s) {
+            for (std::size_t b = 0; b < BUCKET_COUNT; ++b) {
+                into[s].buckets[b] += from[s].buckets[b].load(std::memory_order_relaxed);
+            }
+            into[s].count += from[s].count.load(std::memory_order_relaxed);
+            into[s].sum += from[s].sum.load(std::memory_order_relaxed);
+            uint64_t max = from[s].max.load(std::memory_order_relaxed);
+            if (max > into[s].max) {
+                into[s].max = max;
+            }
+        }
+    }
+
+    std::mutex mtx_;
+    std::vector<ThreadHistograms *> threads_;
+    Snapshot retired_{};
+    std::chrono::steady_clock::time_point start_time_;
+    uint64_t start_ticks_;
+};
+
+struct ThreadHistograms {
+    std::array<StageHistogram, STAGE_COUNT> stages;
+
+    ThreadHistograms() { Registry::instance().add(this); }
+    ~ThreadHistograms() { Registry::instance().retire(this); }
+
+    void record(Stage stage, uint64_t ticks) {
+        StageHistogram &h = stages[static_cast<std::size_t>(stage)];
+        std::size_t bucket = ticks ? 63 - static_cast<std::size_t>(__builtin_clzll(ticks)) : 0;
+        bump(h.buckets[bucket], 1);
+        bump(h.count, 1);
+        bump(h.sum, ticks);
+        if (ticks > h.max.load(std::memory_order_relaxed)) {
+            h.max.store(ticks, std::memory_order_relaxed);
+        }
+    }
+};
+
+inline void Registry::retire(ThreadHistograms *thread) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Snapshot folded{};
+    merge(thread->stages, folded);
+    for (std::size_t s = 0; s < STAGE_COUNT; ++s) {
+        for (std::size_t b = 0; b < BUCKET_COUNT; ++b) {
+            retired_[s].buckets[b] += folded[s].buckets[b];
+        }
+        retired_[s].count += folded[s].count;
+        retired_[s].sum += folded[s].sum;
+        if (folded[s].max > retired_[s].max) {
+            retired_[s].max = folded[s].max;
+        }
+    }
+    for (auto &entry : threads_) {
+        if (entry == thread) {
+            entry = threads_.back();
+            threads_.pop_back();
+            break;
+        }
+    }
+}
+
+inline Snapshot Registry::snapshot() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Snapshot total = retired_;
+    for (ThreadHistograms *thread : threads_) {
+        merge(thread->stages, total);
+    }
+    return total;
+}
+
+inline ThreadHistograms &this_thread_histograms() {
+    static thread_local ThreadHistograms histograms;
+    return histograms;
+}
+
+// Times the enclosing scope into the calling thread's histogram for `stage`
+class ScopedStage {
+public:
+    explicit ScopedStage(Stage stage) : stage_(stage), start_(now_ticks()) {}
+    ~ScopedStage() { this_thread_histograms().record(stage_, now_ticks() - start_); }
+
+    ScopedStage(const ScopedStage &) = delete;
+    ScopedStage &operator=(const ScopedStage &) = delete;
+
+private:
+    Stage stage_;
+    uint64_t start_;
+};
+
+} // namespace timing
+
+#ifdef XEC_ENABLE_TIMERS
+#define XEC_TIMER_CONCAT_(a, b) a##b
+#define XEC_TIMER_CONCAT(a, b) XEC_TIMER_CONCAT_(a, b)
+#define XEC_TIME_STAGE(stage) ::xec::timing::ScopedStage XEC_TIMER_CONCAT(xec_stage_timer_, __LINE__)(stage)
+#else
+#define XEC_TIME_STAGE(stage) ((void)0)
+#endif
+
+constexpr bool stage_timers_enabled() {
+#ifdef XEC_ENABLE_TIMERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Function to write every stage's merged histogram as JSON (durations in seconds)
+inline void write_stage_timers_json(const std::string &filename) {
+    std::ofstream out(filename);
+    if (!out) {
+        throw std::runtime_error("Cannot open output file: " + filename);
+    }
+    timing::Snapshot snapshot = timing::Registry::instance().snapshot();
+    double seconds_per_tick = 1e-9 / timing::Registry::instance().ticks_per_ns();
+    out.precision(9);
+    out << "{\n  \"enabled\": " << (stage_timers_enabled() ? "true" : "false") << ",\n  \"stages\": {";
+    for (std::size_t s = 0; s < timing::STAGE_COUNT; ++s) {
+        const timing::StageSnapshot &stage = snapshot[s];
+        out << (s ? ",\n" : "\n") << "    \"" << stage_name(static_cast<Stage>(s)) << "\": {\"count\": " << stage.count
+            << ", \"sum_s\": " << stage.sum * seconds_per_tick << ", \"max_s\": " << stage.max * seconds_per_tick << ", \"buckets\": [";
+        bool first = true;
+        for (std::size_t b = 0; b < timing::BUCKET_COUNT; ++b) {
+            if (stage.buckets[b] == 0) {
+                continue;
+            }
+            out << (first ? "" : ", ") << "{\"le_s\": " << std::ldexp(1.0, static_cast<int>(b) + 1) * seconds_per_tick
+                << ", \"count\": " << stage.buckets[b] << "}";
+            first = false;
+        }
+        out << "]}";
+    }
+    out << "\n  }\n}\n";
+}
+
+// Function to write every stage's merged histogram in the Prometheus text exposition format
+inline void write_stage_timers_prometheus(const std::string &filename) {
+    std::ofstream out(filename);
+    if (!out) {
+        throw std::runtime_error("Cannot open output file: " + filename);
+    }
+    timing::Snapshot snapshot = timing::Registry::instance().snapshot();
+    double seconds_per_tick = 1e-9 / timing::Registry::instance().ticks_per_ns();
+    out.precision(9);
+    out << "# HELP xec_stage_duration_seconds Time spent per pipeline stage invocation.\n"
+        << "# TYPE xec_stage_duration_seconds histogram\n";
+    for (std::size_t s = 0; s < timing::STAGE_COUNT; ++s) {
+        const timing::StageSnapshot &stage = snapshot[s];
+        const char *name = stage_name(static_cast<Stage>(s));
+        std::size_t last = 0;
+        for (std::size_t b = 0; b < timing::BUCKET_COUNT; ++b) {
+            if (stage.buckets[b]) {
+                last = b;
+            }
+        }
+        uint64_t cumulative = 0;
+        for (std::size_t b = 0; b <= last && stage.count; ++b) {
+            cumulative += stage.buckets[b];
+            out << "xec_stage_duration_seconds_bucket{stage=\"" << name << "\",le=\""
+                << std::ldexp(1.0, static_cast<int>(b) + 1) * seconds_per_tick << "\"} " << cumulative << "\n";
+        }
+        out << "xec_stage_duration_seconds_bucket{stage=\"" << name << "\",le=\"+Inf\"} " << stage.count << "\n"
+            << "xec_stage_duration_seconds_sum{stage=\"" << name << "\"} " << stage.sum * seconds_per_tick << "\n"
+            << "xec_stage_duration_seconds_count{stage=\"" << name << "\"} " << stage.count << "\n";
+    }
+}
+
+// Function to write whichever of the JSON / Prometheus exports was asked for (empty path = skip);
+// failures are reported on stderr so a finished run still exits normally
+inline void export_stage_timers(const std::string &json_filename, const std::string &prometheus_filename) {
+    if (json_filename.empty() && prometheus_filename.empty()) {
+        return;
+    }
+    if (!stage_timers_enabled()) {
+        std::cerr << "Built without -DXEC_ENABLE_TIMERS; stage timers are empty" << std::endl;
+    }
+    try {
+        if (!json_filename.empty()) {
+            write_stage_timers_json(json_filename);
+        }
+        if (!prometheus_filename.empty()) {
+            write_stage_timers_prometheus(prometheus_filename);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error writing stage timers: " << e.what() << std::endl;
+    }
+}
+
+} // namespace xec
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+// Host tuning profile: the chunk size, worker count, in-flight depth and I/O backend that ran
+// fastest on this machine and storage, written by `Bench --tune FILE` (see Bench.cpp).
+//
+// A profile has one setting per line ('#' starts a comment):
+//   chunk_size 2097152
+//   threads 8
+//   in_flight 16
+//   io stream|mmap|uring
+// Settings left out keep the built-in defaults (1 MB chunks, one worker per hardware thread,
+// two chunks in flight per worker, stream I/O). The binaries load --profile FILE, or xec.tune
+// in the working directory when it exists; flags given on the command line override it.
+// Containers record their chunk size, so the decryptors only take threads, in_flight and io.
+namespace xec {
+
+constexpr const char *DEFAULT_TUNE_PROFILE = "xec.tune";
+
+// Function to parse the value of a count or size setting such as --threads; only plain digits
+// are taken, so "x" is reported instead of escaping as std::invalid_argument and "-1" is
+// rejected instead of wrapping to a huge count
+inline uint64_t parse_count(const std::string &name, const std::string &text) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+        throw std::runtime_error(name + " expects a non-negative integer, got '" + text + "'");
+    }
+    try {
+        return std::stoull(text);
+    } catch (const std::out_of_range &) {
+        throw std::runtime_error(name + " value out of range: " + text);
+    }
+}
+
+struct TuneProfile {
+    std::size_t chunk_size = 1048576;
+    std::size_t threads = 0;        // 0: one per hardware thread
+    std::size_t in_flight = 0;      // 0: two per worker
+    std::string io = "stream";
+    std::string source;             // file the profile came from, empty for the defaults
+
+    // Function to read a profile file; unknown settings are rejected so a typo is not silently ignored
+    static TuneProfile load(const std::string &filename) {
+        std::ifstream in(filename);
+        if (!in) {
+            throw std::runtime_error("Cannot open profile: " + filename);
+        }
+        TuneProfile profile;
+        profile.source = filename;
+        std::string line;
+        for (std::size_t line_number = 1; std::getline(in, line); ++line_number) {
+            std::string where = filename + ":" + std::to_string(line_number);
+            std::size_t comment = line.find('#');
+            if (comment != std::string::npos) {
+                line.erase(comment);
+            }
+            std::istringstream fields(line);
+            std::string name, value;
+            if (!(fields >> name)) {
+                continue; // blank line
+            }
+            if (!(fields >> value)) {
+                throw std::runtime_error(where + ": expected <setting> <value>");
+            }
+            try {
+                if (name == "chunk_size") {
+                    profile.chunk_size = parse_count(name, value);
+                } else if (name == "threads") {
+                    profile.threads = parse_count(name, value);
+                } else if (name == "in_flight") {
+                    profile.in_flight = parse_count(name, value);
+                } else if (name == "io") {
+                    profile.io = value;
+                } else {
+                    throw std::runtime_error("unknown setting " + name);
+                }
+            } catch (const std::logic_error &) {
+                throw std::runtime_error(where + ": bad value '" + value + "' for " + name);
+            } catch (const std::runtime_error &e) {
+                throw std::runtime_error(where + ": " + e.what());
+            }
+        }
+        if (profile.chunk_size == 0) {
+            throw std::runtime_error(filename + ": chunk_size must be positive");
+        }
+        if (profile.io != "stream" && profile.io != "mmap" && profile.io != "uring") {
+            throw std::runtime_error(filename + ": io must be stream, mmap or uring, got " + profile.io);
+        }
+        return profile;
+    }
+
+    // Function to write the profile, with `comment` (one line) above the settings
+    void save(const std::string &filename, const std::string &comment) const {
+        std::ofstream out(filename, std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Cannot open output file: " + filename);
+        }
+        out << "# " << comment << "\n"
+            << "chunk_size " << chunk_size << "\n"
+            << "threads " << threads << "\n"
+            << "in_flight " << in_flight << "\n"
+            << "io " << io << "\n";
+        if (!out) {
+            throw std::runtime_error("Cannot write profile: " + filename);
+        }
+    }
+};
+
+// Function to load the profile named by --profile FILE in argv, else DEFAULT_TUNE_PROFILE when
+// it exists, else the defaults; call before parsing the other flags so they override it
+inline TuneProfile load_startup_profile(int argc, char *argv[]) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0) {
+            return TuneProfile::load(argv[i + 1]);
+        }
+    }
+    if (std::filesystem::exists(DEFAULT_TUNE_PROFILE)) {
+        return TuneProfile::load(DEFAULT_TUNE_PROFILE);
+    }
+    return TuneProfile();
+}
+
+} // namespace xec
@@ -0,0 +1,318 @@
+#pragma once
+
+// Optional io_uring backend for chunk reads and writes (--io uring).
+//
+// Compiled in only when XEC_HAVE_LIBURING is defined (build with -DXEC_HAVE_LIBURING -luring);
+// otherwise the binaries keep the ifstream/ofstream path. Reads run `depth` chunks ahead of
+// the pipeline into registered buffers, so the device queue stays full while workers
+// compute; payload writes are queued at their final container offsets and only waited for
+// when every buffer is busy. Chunks change hands by swapping strings with the pipeline's slots,
+// never by copying: a completed read becomes the slot's input and the slot's old buffer is
+// re-registered for the next read; a payload to write is taken the same way.
+#ifdef XEC_HAVE_LIBURING
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <liburing.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace xec {
+
+// One ring plus `depth` registered buffers of `buffer_size` bytes; buffer i is request i.
+// exchange() trades an idle buffer for a caller's string and re-registers it, so the
+// registered set follows the storage as it moves between the ring and the pipeline.
+class UringQueue {
+public:
+    UringQueue(std::size_t buffer_size, std::size_t depth)
+        : buffer_size_(buffer_size), buffers_(depth ? depth : 1, std::string(buffer_size ? buffer_size : 1, '\0')), iovecs_(buffers_.size()) {
+        int rc = io_uring_queue_init(static_cast<unsigned>(iovecs_.size()), &ring_, 0);
+        if (rc < 0) {
+            throw std::runtime_error(std::string("io_uring_queue_init failed: ") + std::strerror(-rc));
+        }
+        for (std::size_t i = 0; i < iovecs_.size(); ++i) {
+            iovecs_[i].iov_base = buffer(i);
+            iovecs_[i].iov_len = buffers_[i].size();
+        }
+        rc = io_uring_register_buffers(&ring_, iovecs_.data(), static_cast<unsigned>(iovecs_.size()));
+        if (rc < 0) {
+            io_uring_queue_exit(&ring_);
+            throw std::runtime_error(std::string("io_uring_register_buffers failed: ") + std::strerror(-rc));
+        }
+    }
+
+    ~UringQueue() { io_uring_queue_exit(&ring_); }
+
+    UringQueue(const UringQueue &) = delete;
+    UringQueue &operator=(const UringQueue &) = delete;
+
+    std::size_t depth() const { return iovecs_.size(); }
+    std::size_t buffer_size() const { return buffer_size_; }
+    char *buffer(std::size_t index) { return &buffers_[index][0]; }
+
+    // Function to swap idle buffer `index` with `data`, keeping at least `min_size` bytes in the
+    // buffer, and register its new storage. Only the string handles move; no bytes are copied,
+    // and once every string has been through the ring no memory is allocated either.
+    void exchange(std::size_t index, std::string &data, std::size_t min_size) {
+        buffers_[index].swap(data);
+        std::string &storage = buffers_[index];
+        if (storage.size() < std::max<std::size_t>(min_size, 1)) {
+            storage.resize(std::max<std::size_t>(min_size, 1));
+        }
+        iovec &iov = iovecs_[index];
+        if (iov.iov_base == storage.data() && iov.iov_len == storage.size()) {
+            return;
+        }
+        iov.iov_base = &storage[0];
+        iov.iov_len = storage.size();
+        int rc = io_uring_register_buffers_update_tag(&ring_, static_cast<unsigned>(index), &iov, nullptr, 1);
+        if (rc < 0) {
+            throw std::runtime_error(std::string("io_uring_register_buffers_update_tag failed: ") + std::strerror(-rc));
+        }
+    }
+
+    // Function to queue a fixed-buffer read/write of `size` bytes at buffer `index` + `skip`
+    void submit(bool write, int fd, std::size_t index, std::size_t skip, std::size_t size, uint64_t offset) {
+        io_uring_sqe *sqe = io_uring_get_sqe(&ring_);
+        if (!sqe) {
+            throw std::runtime_error("io_uring submission queue full");
+        }
+        if (write) {
+            io_uring_prep_write_fixed(sqe, fd, buffer(index) + skip, static_cast<unsigned>(size), offset, static_cast<int>(index));
+        } else {
+            io_uring_prep_read_fixed(sqe, fd, buffer(index) + skip, static_cast<unsigned>(size), offset, static_cast<int>(index));
+        }
+        sqe->user_data = index;
+        int rc = io_uring_submit(&ring_);
+        if (rc < 0) {
+            throw std::runtime_error(std::string("io_uring_submit failed: ") + std::strerror(-rc));
+        }
+    }
+
+    // Function to wait for one completion; returns its buffer index and byte count
+    std::size_t complete_one(std::size_t &bytes) {
+        io_uring_cqe *cqe = nullptr;
+        int rc = io_uring_wait_cqe(&ring_, &cqe);
+        if (rc < 0) {
+            throw std::runtime_error(std::string("io_uring_wait_cqe failed: ") + std::strerror(-rc));
+        }
+        int res = cqe->res;
+        std::size_t index = static_cast<std::size_t>(cqe->user_data);
+        io_uring_cqe_seen(&ring_, cqe);
+        if (res < 0) {
+            throw std::runtime_error(std::string("io_uring I/O failed: ") + std::strerror(-res));
+        }
+        bytes = static_cast<std::size_t>(res);
+        return index;
+    }
+
+private:
+    io_uring ring_;
+    std::size_t buffer_size_;
+    std::vector<std::string> buffers_;
+    std::vector<iovec> iovecs_;
+};
+
+// Function to read a file front to back in chunk_size pieces, keeping `depth` reads in flight
+class UringChunkReader {
+public:
+    UringChunkReader(const std::string &filename, std::size_t chunk_size, std::size_t depth)
+        : queue_(chunk_size, depth), requests_(queue_.depth()) {
+        fd_ = ::open(filename.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot open file: " + filename + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (::fstat(fd_, &st) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("Cannot stat file: " + filename + ": " + std::strerror(errno));
+        }
+        file_size_ = static_cast<uint64_t>(st.st_size);
+        for (std::size_t i = 0; i < queue_.depth(); ++i) {
+            start(i, i);
+        }
+    }
+
+    ~UringChunkReader() {
+        // The kernel may still be filling buffers; drain before they are freed
+        try {
+            for (std::size_t i = 0; i < requests_.size(); ++i) {
+                while (requests_[i].in_flight) {
+                    std::size_t bytes = 0;
+                    requests_[queue_.complete_one(bytes)].in_flight = false;
+                }
+            }
+        } catch (...) {
+        }
+        ::close(fd_);
+    }
+
+    UringChunkReader(const UringChunkReader &) = delete;
+    UringChunkReader &operator=(const UringChunkReader &) = delete;
+
+    // Function to hand the next chunk in file order over in `data`, which gives its old storage
+    // to the ring for a later read; returns false at end of file
+    bool next(std::string &data) {
+        if (next_chunk_ * queue_.buffer_size() >= file_size_) {
+            return false;
+        }
+        std::size_t index = next_chunk_ % requests_.size();
+        while (requests_[index].in_flight) {
+            std::size_t bytes = 0;
+            std::size_t done = queue_.complete_one(bytes);
+            Request &request = requests_[done];
+            request.in_flight = false;
+            if (bytes == 0) {
+                throw std::runtime_error("Unexpected end of file in chunk " + std::to_string(request.chunk));
+            }
+            request.filled += bytes;
+            if (request.filled < request.size) {
+                resubmit(done); // short read: fetch the rest of the chunk
+            }
+        }
+        const Request &request = requests_[index];
+        queue_.exchange(index, data, queue_.buffer_size());
+        data.resize(request.size); // only the file's last chunk is shorter, and shrinking never copies
+        start(index, next_chunk_ + requests_.size());
+        ++next_chunk_;
+        return true;
+    }
+
+private:
+    struct Request {
+        uint64_t chunk = 0;
+        std::size_t size = 0;
+        std::size_t filled = 0;
+        bool in_flight = false;
+    };
+
+    // Function to start reading `chunk` into buffer `index` (chunk c always uses buffer c % depth)
+    void start(std::size_t index, uint64_t chunk) {
+        uint64_t offset = chunk * queue_.buffer_size();
+        if (offset >= file_size_) {
+            return;
+        }
+        Request &request = requests_[index];
+        request.chunk = chunk;
+        request.size = static_cast<std::size_t>(std::min<uint64_t>(queue_.buffer_size(), file_size_ - offset));
+        request.filled = 0;
+        resubmit(index);
+    }
+
+    void resubmit(std::size_t index) {
+        Request &request = requests_[index];
+        request.in_flight = true;
+        queue_.submit(false, fd_, index, request.filled, request.size - request.filled,
+                      request.chunk * queue_.buffer_size() + request.filled);
+    }
+
+    UringQueue queue_;
+    std::vector<Request> requests_;
+    int fd_ = -1;
+    uint64_t file_size_ = 0;
+    uint64_t next_chunk_ = 0;
+};
+
+// Function to write byte runs at given offsets of an existing file, keeping up to `depth` in flight
+class UringChunkWriter {
+public:
+    UringChunkWriter(const std::string &filename, std::size_t buffer_size, std::size_t depth)
+        : queue_(buffer_size, depth), requests_(queue_.depth()) {
+        fd_ = ::open(filename.c_str(), O_WRONLY);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot open output file: " + filename + ": " + std::strerror(errno));
+        }
+    }
+
+    ~UringChunkWriter() {
+        try {
+            drain();
+        } catch (...) {
+        }
+        ::close(fd_);
+    }
+
+    UringChunkWriter(const UringChunkWriter &) = delete;
+    UringChunkWriter &operator=(const UringChunkWriter &) = delete;
+
+    // Function to queue `data` for writing at `offset`. The ring takes the string itself and gives
+    // `data` the storage of an idle buffer (contents unspecified) in return, so nothing is copied
+    // and the caller may refill `data` at once. Blocks only while every registered buffer is busy.
+    void write(uint64_t offset, std::string &data) {
+        if (data.empty()) {
+            return;
+        }
+        std::size_t index = free_buffer();
+        Request &request = requests_[index];
+        request.offset = offset;
+        request.size = data.size();
+        request.written = 0;
+        queue_.exchange(index, data, 0);
+        resubmit(index);
+    }
+
+    // Function to wait until every queued write has reached the file
+    void drain() {
+        for (std::size_t i = 0; i < requests_.size(); ++i) {
+            while (requests_[i].in_flight) {
+                complete_one();
+            }
+        }
+    }
+
+private:
+    struct Request {
+        uint64_t offset = 0;
+        std::size_t size = 0;
+        std::size_t written = 0;
+        bool in_flight = false;
+    };
+
+    std::size_t free_buffer() {
+        for (;;) {
+            for (std::size_t i = 0; i < requests_.size(); ++i) {
+                if (!requests_[i].in_flight) {
+                    return i;
+                }
+            }
+            complete_one();
+        }
+    }
+
+    void complete_one() {
+        std::size_t bytes = 0;
+        std::size_t done = queue_.complete_one(bytes);
+        Request &request = requests_[done];
+        request.in_flight = false;
+        if (bytes == 0) {
+            throw std::runtime_error("io_uring write made no progress");
+        }
+        request.written += bytes;
+        if (request.written < request.size) {
+            resubmit(done); // short write: queue the remainder
+        }
+    }
+
+    void resubmit(std::size_t index) {
+        Request &request = requests_[index];
+        request.in_flight = true;
+        queue_.submit(true, fd_, index, request.written, request.size - request.written, request.offset + request.written);
+    }
+
+    UringQueue queue_;
+    std::vector<Request> requests_;
+    int fd_ = -1;
+};
+
+} // namespace xec
+
+#endif // XEC_HAVE_LIBURING
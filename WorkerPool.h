@@ -0,0 +1,323 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CpuTopology.h"
+
+// Persistent work-stealing pool shared by the parallel encryptor and decryptor.
+//
+// Each worker owns a deque: it pops its own work from the back (most recently
+// queued, still warm in cache) and, when empty, steals from the front of the other
+// workers' deques. Tasks submitted from outside the pool are dealt round-robin; tasks
+// submitted from inside a worker go to that worker's own deque. The deques are rings that
+// only ever grow, so once warm, submitting a task whose callable fits in std::function's
+// inline storage (two pointers) does not touch the heap.
+//
+// A pool built with a CpuTopology pins each worker to one CPU and groups the workers by NUMA
+// node. Workers then steal only from workers on their own node, so a task handed to
+// submit_to_node() runs on that node; without a topology the whole pool is one node.
+namespace xec {
+
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    // worker_count == 0 means one worker per hardware thread (per usable CPU of `pin_to`).
+    // With `pin_to`, worker i runs on node i % nodes, on that node's CPUs in turn; nodes
+    // beyond worker_count get no workers and are not used.
+    explicit WorkerPool(std::size_t worker_count = 0, const CpuTopology *pin_to = nullptr) {
+        if (worker_count == 0) {
+            worker_count = pin_to ? pin_to->cpu_count() : std::thread::hardware_concurrency();
+        }
+        if (worker_count == 0) {
+            worker_count = 1;
+        }
+        std::size_t nodes = pin_to ? std::min(pin_to->node_count(), worker_count) : 1;
+        node_workers_.resize(nodes);
+        for (std::size_t i = 0; i < worker_count; ++i) {
+            queues_.emplace_back(new WorkerQueue());
+            worker_node_.push_back(i % nodes);
+            node_workers_[i % nodes].push_back(i);
+        }
+        queued_.assign(nodes, 0);
+        wake_cv_ = std::vector<std::condition_variable>(nodes);
+        // A worker that cannot be started or pinned stops the ones already running, so the
+        // constructor throws instead of destroying joinable threads
+        try {
+            for (std::size_t i = 0; i < worker_count; ++i) {
+                threads_.emplace_back(&WorkerPool::run, this, i);
+            }
+            if (pin_to) {
+                for (std::size_t i = 0; i < worker_count; ++i) {
+                    const std::vector<int> &cpus = pin_to->node_cpus[worker_node_[i]];
+                    pin_thread(threads_[i].native_handle(), cpus[(i / nodes) % cpus.size()]);
+                }
+            }
+        } catch (...) {
+            stop_workers();
+            throw;
+        }
+    }
+
+    ~WorkerPool() { stop_workers(); }
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    std::size_t size() const { return threads_.size(); }
+
+    // Nodes that have workers; 1 unless the pool was built with a topology
+    std::size_t node_count() const { return node_workers_.size(); }
+
+    std::size_t worker_node(std::size_t worker) const { return worker_node_[worker]; }
+
+    // Index of the calling worker, or size() when called from a non-pool thread
+    std::size_t current_worker() const {
+        return current_pool() == this ? current_index() : size();
+    }
+
+    void submit(Task task) {
+        std::size_t target = current_worker();
+        if (target == size()) {
+            target = next_queue_.fetch_add(1, std::memory_order_relaxed) % size();
+        }
+        push(target, std::move(task));
+    }
+
+    // Function to queue `task` on a worker of `node` (the caller's own deque if it is one)
+    void submit_to_node(std::size_t node, Task task) {
+        std::size_t target = current_worker();
+        if (target == size() || worker_node_[target] != node) {
+            const std::vector<std::size_t> &workers = node_workers_[node];
+            target = workers[next_queue_.fetch_add(1, std::memory_order_relaxed) % workers.size()];
+        }
+        push(target, std::move(task));
+    }
+
+    // Function to block until every submitted task has finished; rethrows the first task exception
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(idle_mtx_);
+        idle_cv_.wait(lock, [this] { return pending_.load(std::memory_order_acquire) == 0; });
+        if (error_) {
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    // Double-ended ring of tasks; its storage doubles when full and is never given back
+    class TaskDeque {
+    public:
+        bool empty() const { return count_ == 0; }
+
+        void push_back(Task task) {
+            if (count_ == slots_.size()) {
+                grow();
+            }
+            slots_[(head_ + count_) % slots_.size()] = std::move(task);
+            ++count_;
+        }
+
+        void pop_back(Task &task) {
+            take(task, (head_ + count_ - 1) % slots_.size());
+            --count_;
+        }
+
+        void pop_front(Task &task) {
+            take(task, head_);
+            head_ = (head_ + 1) % slots_.size();
+            --count_;
+        }
+
+    private:
+        void take(Task &task, std::size_t index) {
+            task = std::move(slots_[index]);
+            slots_[index] = nullptr;
+        }
+
+        void grow() {
+            std::vector<Task> bigger(slots_.empty() ? 16 : 2 * slots_.size());
+            for (std::size_t i = 0; i < count_; ++i) {
+                bigger[i] = std::move(slots_[(head_ + i) % slots_.size()]);
+            }
+            slots_.swap(bigger);
+            head_ = 0;
+        }
+
+        std::vector<Task> slots_;
+        std::size_t head_ = 0;
+        std::size_t count_ = 0;
+    };
+
+    struct alignas(64) WorkerQueue {
+        std::mutex mtx;
+        TaskDeque tasks;
+    };
+
+    static const WorkerPool *&current_pool() {
+        static thread_local const WorkerPool *pool = nullptr;
+        return pool;
+    }
+
+    static std::size_t &current_index() {
+        static thread_local std::size_t index = 0;
+        return index;
+    }
+
+    void push(std::size_t target, Task task) {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(queues_[target]->mtx);
+            queues_[target]->tasks.push_back(std::move(task));
+        }
+        std::size_t node = worker_node_[target];
+        {
+            std::lock_guard<std::mutex> lock(wake_mtx_);
+            ++queued_[node];
+        }
+        wake_cv_[node].notify_one();
+    }
+
+    bool try_take(std::size_t self, Task &task) {
+        {
+            WorkerQueue &own = *queues_[self];
+            std::lock_guard<std::mutex> lock(own.mtx);
+            if (!own.tasks.empty()) {
+                own.tasks.pop_back(task);
+                return true;
+            }
+        }
+        const std::vector<std::size_t> &peers = node_workers_[worker_node_[self]];
+        std::size_t position = self / node_count(); // self == peers[position]
+        for (std::size_t offset = 1; offset < peers.size(); ++offset) {
+            WorkerQueue &victim = *queues_[peers[(position + offset) % peers.size()]];
+            std::lock_guard<std::mutex> lock(victim.mtx);
+            if (!victim.tasks.empty()) {
+                victim.tasks.pop_front(task);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Function to let the workers drain their queues and exit, then join them
+    void stop_workers() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mtx_);
+            stop_ = true;
+        }
+        for (auto &cv : wake_cv_) {
+            cv.notify_all();
+        }
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void run(std::size_t self) {
+        current_pool() = this;
+        current_index() = self;
+        const std::size_t node = worker_node_[self];
+        Task task;
+        for (;;) {
+            if (try_take(self, task)) {
+                {
+                    std::lock_guard<std::mutex> lock(wake_mtx_);
+                    --queued_[node];
+                }
+                try {
+                    task();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(idle_mtx_);
+                    if (!error_) {
+                        error_ = std::current_exception();
+                    }
+                }
+                task = nullptr;
+                if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> lock(idle_mtx_);
+                    idle_cv_.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(wake_mtx_);
+            wake_cv_[node].wait(lock, [&] { return queued_[node] > 0 || stop_; });
+            if (stop_ && queued_[node] == 0) {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::vector<std::size_t> worker_node_;
+    std::vector<std::vector<std::size_t>> node_workers_;
+    std::atomic<std::size_t> next_queue_{0};
+    std::atomic<std::size_t> pending_{0};
+
+    std::mutex wake_mtx_;
+    std::vector<std::condition_variable> wake_cv_; // per node
+    std::vector<std::size_t> queued_;              // tasks queued per node
+    bool stop_ = false;
+
+    std::mutex idle_mtx_;
+    std::condition_variable idle_cv_;
+    std::exception_ptr error_;
+};
+
+namespace detail {
+
+// Function to run fn(index) for index in [0, count), spread over the pool's nodes, or inline when
+// `pool` is null. Only these tasks are waited for, so several callers can share the pool; the
+// first exception one of them throws is rethrown once all have finished. Tasks capture only
+// `fn` and their index, so submitting one does not allocate.
+template <typename Fn>
+void run_chunk_tasks(WorkerPool *pool, uint64_t count, Fn &fn) {
+    if (!pool) {
+        for (uint64_t index = 0; index < count; ++index) {
+            fn(index);
+        }
+        return;
+    }
+    std::mutex done_mtx;
+    std::condition_variable done_cv;
+    uint64_t remaining = count;
+    std::exception_ptr error;
+    auto run_one = [&](uint64_t index) {
+        std::exception_ptr failure;
+        try {
+            fn(index);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(done_mtx);
+        if (failure && !error) {
+            error = failure;
+        }
+        if (--remaining == 0) {
+            done_cv.notify_all();
+        }
+    };
+    for (uint64_t index = 0; index < count; ++index) {
+        pool->submit_to_node(index % pool->node_count(), [&run_one, index]() { run_one(index); });
+    }
+    std::unique_lock<std::mutex> lock(done_mtx);
+    done_cv.wait(lock, [&] { return remaining == 0; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace detail
+
+} // namespace xec
@@ -1,89 +1,139 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <bitset>
 #include <chrono>
 #include <iomanip>
 #include <string>
-
-// Key for encryption and decryption
-std::bitset<256> key("110100101101111010010111101010111000110011001011110110001111010000111001010011111100110100101100100110100011100101011110110101011011001001100010111010110011111010001001110100100010010011000101100110101010011011000111101001100100010110111110110001011001101");
-
-// Function to reverse mutation on a 256-bit segment
-void reverse_mutate(std::bitset<256> &segment) {
-    std::vector<size_t> bits_to_flip = {50, 100, 150}; // Original mutation positions
-    for (size_t bit : bits_to_flip) {
-        if (bit < segment.size()) {
-            segment.flip(bit);
-        }
+#include <cstring>
+#include "CipherContainer.h"
+#include "ChunkChecksum.h"
+#include "ChunkCompression.h"
+#include "ChunkEngine.h"
+#include "SegmentCipher.h"
+#include "MappedFile.h"
+#include "StageTimer.h"
+#include "TuneProfile.h"
+#include "CipherStats.h"
+
+// Same 256-bit cipher as ParaEn; decryption applies the identical compile-time mask
+using Cipher = xec::XecCipher256;
+
+// Function to reject a container this decryptor cannot read: another segment width, or a key
+// file key (only ParaDec --key-file has those)
+void check_container(const xec::ContainerHeader &header, const std::string &encrypted_filename) {
+    if (header.segment_bits != Cipher::width) {
+        throw std::runtime_error("Expected " + std::to_string(Cipher::width) + "-bit segments, container has " + std::to_string(header.segment_bits));
+    }
+    std::string key_id = xec::container_key_id(header);
+    if (!key_id.empty()) {
+        throw std::runtime_error(encrypted_filename + " was encrypted with key " + key_id + "; decrypt it with ParaDec --key-file");
     }
 }
 
-// Function to reverse crossover (XOR with key)
-void reverse_crossover(std::bitset<256> &segment) {
-    segment ^= key; // XOR with key again to revert
-}
-
-// Function to decrypt a binary chunk by reversing encryption steps
-std::string decrypt_chunk(const std::string &binary_chunk) {
-    std::vector<std::bitset<256>> segments;
-    size_t segment_count = binary_chunk.size() / 256;
+// Chunks resident between decryption and the writer thread, as for XecLDS_SDS
+constexpr std::size_t IN_FLIGHT = 4;
 
-    for (size_t i = 0; i < segment_count; ++i) {
-        std::bitset<256> segment(binary_chunk.substr(i * 256, 256));
-
-        // Reverse mutation and crossover
-        reverse_mutate(segment);
-        reverse_crossover(segment);
-
-        segments.push_back(segment);
-    }
-
-    std::string decrypted_chunk;
-    for (const auto &segment : segments) {
-        decrypted_chunk += segment.to_string();
+// Function to decrypt an encrypted file on this thread and measure decryption time. Both backends
+// are the shared engines of ChunkEngine.h without a pool: the stream one hands finished chunks
+// to a writer thread while the next ones decrypt, the mapped one decrypts straight between
+// mappings of the container and the output file.
+void decrypt_file(const std::string &encrypted_filename, const std::string &decrypted_filename, bool mapped_io,
+                  double &decryption_time_s, double &throughput) {
+    check_container(xec::ContainerReader("output/" + encrypted_filename).header(), encrypted_filename);
+    xec::CipherStats stats;
+    auto start = std::chrono::high_resolution_clock::now(); // Start timing
+    if (mapped_io) {
+        xec::decrypt_file_mapped(Cipher(), "output/" + encrypted_filename, "plaintext/" + decrypted_filename, nullptr, stats);
+    } else {
+        xec::decrypt_file_in_chunks(Cipher(), "output/" + encrypted_filename, "plaintext/" + decrypted_filename, nullptr, IN_FLIGHT, stats);
     }
+    auto end = std::chrono::high_resolution_clock::now(); // End timing
+    std::chrono::duration<double> duration = end - start;
+    decryption_time_s = duration.count();
 
-    return decrypted_chunk;
+    // Calculate throughput as (plaintext bytes produced / decryption time)
+    throughput = stats.totals().bytes / decryption_time_s;
 }
 
-// Function to read an encrypted file, decrypt it, and measure decryption time
-void decrypt_file(const std::string &encrypted_filename, const std::string &decrypted_filename, 
-                  double &decryption_time_s, double &throughput) {
-    std::ifstream encrypted_file("output/" + encrypted_filename);
-    std::ofstream decrypted_file("plaintext/" + decrypted_filename);
-    if (!encrypted_file || !decrypted_file) {
-        throw std::runtime_error("Cannot open encrypted or decrypted file.");
+// Function to decrypt only plaintext bytes [offset, offset + length) of an encrypted file via the chunk index
+void decrypt_file_range(const std::string &encrypted_filename, const std::string &decrypted_filename, uint64_t offset, uint64_t length,
+                        double &decryption_time_s, double &throughput) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    xec::ContainerReader reader("output/" + encrypted_filename);
+    check_container(reader.header(), encrypted_filename);
+    std::string plaintext;
+    if (reader.compressed()) {
+        xec::ChunkCodec codec(0);
+        xec::decrypt_compressed_range(reader, offset, length, plaintext, Cipher(), codec);
+    } else {
+        xec::decrypt_range<Cipher>(reader, offset, length, plaintext);
     }
 
-    std::string binary_chunk;
-    auto start = std::chrono::high_resolution_clock::now(); // Start timing
-    
-    while (std::getline(encrypted_file, binary_chunk)) {
-        std::string decrypted_chunk = decrypt_chunk(binary_chunk);
-        decrypted_file << decrypted_chunk;
+    std::ofstream decrypted_file("plaintext/" + decrypted_filename, std::ios::binary);
+    if (!decrypted_file) {
+        throw std::runtime_error("Cannot open decrypted file.");
     }
+    decrypted_file.write(plaintext.data(), plaintext.size());
 
-    auto end = std::chrono::high_resolution_clock::now(); // End timing
+    auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> duration = end - start;
     decryption_time_s = duration.count();
 
-    // Calculate throughput as (file size in bytes / decryption time)
-    encrypted_file.clear();
-    encrypted_file.seekg(0, std::ios::end);
-    double file_size_bytes = encrypted_file.tellg();
-    throughput = file_size_bytes / decryption_time_s;
+    // Throughput of a range read is measured over the bytes requested
+    throughput = length / decryption_time_s;
 }
 
 // Main function to decrypt each file in the list of datasets and calculate metrics
-int main() {
+int main(int argc, char *argv[]) {
+    // --io stream|mmap selects buffered streams or the zero-copy mapped backend
+    // --range OFFSET LENGTH decrypts only those plaintext bytes of each file (to decrypted_<stem>_range.txt)
+    // --timers-json FILE / --timers-prom FILE export per-stage latency histograms (JSON /
+    //   Prometheus text format); build with -DXEC_ENABLE_TIMERS to record them
+    // --profile FILE takes the I/O backend from a Bench --tune profile (default: xec.tune when
+    //   present, see TuneProfile.h; uring decrypts with the stream backend)
+    xec::TuneProfile profile;
+    try {
+        profile = xec::load_startup_profile(argc, argv);
+    } catch (const std::exception &e) {
+        std::cerr << "Error loading profile: " << e.what() << std::endl;
+        return 1;
+    }
+    bool mapped_io = profile.io == "mmap";
+    std::string timers_json, timers_prom;
+    bool range_mode = false;
+    uint64_t range_offset = 0, range_length = 0;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--io") == 0 && i + 1 < argc) {
+                mapped_io = std::strcmp(argv[++i], "mmap") == 0;
+            } else if (std::strcmp(argv[i], "--range") == 0 && i + 2 < argc) {
+                range_mode = true;
+                range_offset = xec::parse_count("--range", argv[++i]);
+                range_length = xec::parse_count("--range", argv[++i]);
+            } else if (std::strcmp(argv[i], "--timers-json") == 0 && i + 1 < argc) {
+                timers_json = argv[++i];
+            } else if (std::strcmp(argv[i], "--timers-prom") == 0 && i + 1 < argc) {
+                timers_prom = argv[++i];
+            } else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+                ++i; // loaded above
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    if (!profile.source.empty()) {
+        std::cerr << "Using profile " << profile.source << std::endl;
+    }
+
     std::vector<std::string> encrypted_datasets = {
 
-     "encrypted_D1.txt", "encrypted_D2.txt", "encrypted_D3.txt",
-        "encrypted_D4.txt", "encrypted_D5.txt", "encrypted_D6.txt",
+     "encrypted_D1.xec", "encrypted_D2.xec", "encrypted_D3.xec",
+        "encrypted_D4.xec", "encrypted_D5.xec", "encrypted_D6.xec",
 
-        "encrypted_D7.txt", "encrypted_D8.txt", "encrypted_D9.txt",
-        "encrypted_D10.txt", "encrypted_D11.txt", "encrypted_D12.txt"
+        "encrypted_D7.xec", "encrypted_D8.xec", "encrypted_D9.xec",
+        "encrypted_D10.xec", "encrypted_D11.xec", "encrypted_D12.xec"
 
     };
 
@@ -94,9 +144,15 @@ int main() {
 
     for (const auto &encrypted_filename : encrypted_datasets) {
         try {
-            std::string decrypted_filename = "decrypted_" + encrypted_filename.substr(encrypted_filename.find_last_of("_") + 1);
+            std::string stem = encrypted_filename.substr(encrypted_filename.find_last_of("_") + 1);
+            std::string decrypted_filename = "decrypted_" + stem.substr(0, stem.find_last_of(".")) + ".txt";
             double decryption_time_s = 0.0, throughput = 0.0;
-            decrypt_file(encrypted_filename, decrypted_filename, decryption_time_s, throughput);
+            if (range_mode) {
+                decrypt_file_range(encrypted_filename, "decrypted_" + stem.substr(0, stem.find_last_of(".")) + "_range.txt",
+                                   range_offset, range_length, decryption_time_s, throughput);
+            } else {
+                decrypt_file(encrypted_filename, decrypted_filename, mapped_io, decryption_time_s, throughput);
+            }
 
             // Convert decryption time to milliseconds and microseconds
             double decryption_time_ms = decryption_time_s * 1000;
@@ -113,6 +169,7 @@ int main() {
         }
     }
 
+    xec::export_stage_timers(timers_json, timers_prom);
     return 0;
 }
 
@@ -1,10 +1,21 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <sstream>
-#include <bitset>
 #include <chrono>
 #include <iomanip> // For tabular formatting
+#include <cstring>
+#include <filesystem>
+#include "CipherContainer.h"
+#include "SegmentCipher.h"
+#include "ChunkRing.h"
+#include "MappedFile.h"
+#include "StageTimer.h"
+#include "CipherStats.h"
+#include "ChunkManifest.h"
+#include "ChunkChecksum.h"
+#include "ChunkCompression.h"
+#include "ChunkEngine.h"
+#include "TuneProfile.h"
 
 // Function to get the size of the file in bytes
 std::streampos getFileSize(const std::string &filename) {
@@ -12,106 +23,108 @@ std::streampos getFileSize(const std::string &filename) {
     return in.tellg();
 }
 
-// Function to convert a text chunk to binary
-void text_to_binary(const std::string &chunk, std::string &binary_result) {
-    std::stringstream binary_stream;
-    for (char ch : chunk) {
-        binary_stream << std::bitset<8>(ch);
-    }
-    binary_result = binary_stream.str();
-}
-
-// Function to apply two-point crossover between 128-bit segments
-void single_point_crossover(std::bitset<128> &segment) {
-    std::bitset<128> key("01010000011001010110000101100011011001010010000001110111011010010111010001101000001000000110100001101111011011100110111101110010");
-    segment ^= key;
-}
-
-// Function to apply mutation on a 128-bit segment (flip one bit)
-void mutate(std::bitset<128> &segment) {
-    size_t bit_to_flip = 50;
-    segment.flip(bit_to_flip);
-}
-
-// Function to calculate Hamming distance (count number of differing bits)
-size_t hamming_distance(const std::bitset<128> &a, const std::bitset<128> &b) {
-    return (a ^ b).count(); // XOR the two bitsets and count the number of 1s (differing bits)
-}
+// 128-bit cipher (key XOR, flip at bit 50); crossover and mutation are folded into one compile-time mask
+using Cipher = xec::XecCipher128;
 
-// Function to convert a 1024-bit chunk (as a string) into multiple 128-bit segments
-std::vector<std::bitset<128>> convert_chunk_to_segments(const std::string &chunk) {
-    std::vector<std::bitset<128>> segments;
-    size_t segment_count = chunk.size() / 128;
-    for (size_t i = 0; i < segment_count; ++i) {
-        std::bitset<128> segment(chunk.substr(i * 128, 128));
-        segments.push_back(segment);
-    }
-    return segments;
-}
-
-// Function to convert multiple 128-bit segments to a 1024-bit chunk
-std::string convert_segments_to_chunk(const std::vector<std::bitset<128>> &segments) {
-    std::string chunk;
-    for (const auto &segment : segments) {
-        chunk += segment.to_string();
+// Main function with modified output formatting
+int main(int argc, char *argv[]) {
+    // --text-export additionally writes the legacy '0'/'1' text ciphertext for debugging
+    // --in-flight N caps the chunks resident between encryption and the writer (default: 4)
+    // --io stream|mmap selects buffered streams or the zero-copy mapped backend (no text export)
+    // --timers-json FILE / --timers-prom FILE export per-stage latency histograms (JSON /
+    //   Prometheus text format); build with -DXEC_ENABLE_TIMERS to record them
+    // --incremental re-encrypts only the chunks that changed since the last run, patching the
+    //   container in place (see ChunkManifest.h); the first run writes the manifest
+    // --compress LEVEL deflates each chunk at zlib level 1-9 before encrypting it (needs a build
+    //   with -DXEC_HAVE_ZLIB -lz; stream backend only); the table adds the compression ratio
+    // --chunk-size BYTES sets the plaintext bytes per chunk (default 1 MB)
+    // --profile FILE takes the chunk size and I/O backend from a Bench --tune profile (default:
+    //   xec.tune when present, see TuneProfile.h; a uring profile runs the stream backend here)
+    xec::TuneProfile profile;
+    try {
+        profile = xec::load_startup_profile(argc, argv);
+    } catch (const std::exception &e) {
+        std::cerr << "Error loading profile: " << e.what() << std::endl;
+        return 1;
     }
-    return chunk;
-}
-
-// Function to read file in chunks sequentially and calculate Avalanche Effect
-void read_file_in_chunks(const std::string &filename, std::size_t chunk_size, std::vector<std::string> &output_list, double &total_avalanche_effect, size_t &total_bits_processed) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) {
-        throw std::runtime_error("Cannot open file: " + filename);
+    bool text_export = false;
+    std::string compress_arg;
+    bool incremental = false;
+    bool mapped_io = profile.io == "mmap";
+    std::size_t chunk_size = profile.chunk_size;
+    std::size_t in_flight = 4;
+    std::string timers_json, timers_prom;
+    bool io_given = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--text-export") == 0) {
+                text_export = true;
+            } else if (std::strcmp(argv[i], "--incremental") == 0) {
+                incremental = true;
+            } else if (std::strcmp(argv[i], "--compress") == 0 && i + 1 < argc) {
+                compress_arg = argv[++i];
+            } else if (std::strcmp(argv[i], "--in-flight") == 0 && i + 1 < argc) {
+                in_flight = xec::parse_count("--in-flight", argv[++i]);
+            } else if (std::strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc) {
+                chunk_size = xec::parse_count("--chunk-size", argv[++i]);
+            } else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+                ++i; // loaded above
+            } else if (std::strcmp(argv[i], "--timers-json") == 0 && i + 1 < argc) {
+                timers_json = argv[++i];
+            } else if (std::strcmp(argv[i], "--timers-prom") == 0 && i + 1 < argc) {
+                timers_prom = argv[++i];
+            } else if (std::strcmp(argv[i], "--io") == 0 && i + 1 < argc) {
+                mapped_io = std::strcmp(argv[++i], "mmap") == 0;
+                io_given = true;
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
     }
-
-    std::string chunk;
-    while (file.good()) {
-        chunk.resize(chunk_size);
-        file.read(&chunk[0], chunk_size);
-        chunk.resize(file.gcount());
-
-        if (chunk.empty()) {
-            break;
+    if (incremental) {
+        // The incremental path maps the input and patches the container in place with its own I/O
+        const char *conflict = text_export ? "--text-export" : io_given && mapped_io ? "--io mmap" : nullptr;
+        if (conflict) {
+            std::cerr << "Error: --incremental patches payloads in place and cannot be combined with " << conflict << std::endl;
+            return 1;
         }
-
-        std::string binary_result;
-        text_to_binary(chunk, binary_result);
-        auto segments = convert_chunk_to_segments(binary_result);
-
-        for (auto &segment : segments) {
-            std::bitset<128> original_segment = segment;
-
-            // Apply crossover and mutation
-            single_point_crossover(segment);
-            mutate(segment);
-
-            // Calculate Hamming distance (Avalanche Effect)
-            size_t flipped_bits = hamming_distance(original_segment, segment);
-            total_avalanche_effect += flipped_bits;
-
-            total_bits_processed += 128; // Count total bits (128 bits per segment)
+        if (mapped_io) {
+            std::cerr << "--incremental uses its own I/O; ignoring the profile's io " << profile.io << std::endl;
+            mapped_io = false;
         }
-
-        binary_result = convert_segments_to_chunk(segments);
-        output_list.push_back(binary_result);
     }
-}
-
-// Function to write binary data to a text file
-void write_binary_to_file(const std::string &output_filename, const std::vector<std::string> &binary_output) {
-    std::ofstream outfile(output_filename);
-    if (!outfile) {
-        throw std::runtime_error("Cannot open output file");
+    if (chunk_size == 0) {
+        std::cerr << "Error: --chunk-size must be positive" << std::endl;
+        return 1;
     }
-
-    for (const auto &binary_chunk : binary_output) {
-        outfile << binary_chunk << "\n";
+    if (!profile.source.empty()) {
+        std::cerr << "Using profile " << profile.source << std::endl;
+    }
+    int compress_level = 0;
+    if (!compress_arg.empty()) {
+        try {
+            compress_level = xec::parse_compress_level(compress_arg);
+            if (incremental) {
+                throw std::runtime_error("--incremental patches payloads in place and cannot be combined with --compress");
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        if (!xec::COMPRESSION_AVAILABLE) {
+            std::cerr << "Built without zlib; writing uncompressed containers" << std::endl;
+            compress_level = 0;
+        } else if (mapped_io) {
+            std::cerr << "--compress needs the stream backend; using it instead of mmap" << std::endl;
+            mapped_io = false;
+        }
+    }
+    if (text_export && mapped_io) {
+        std::cerr << "--text-export needs the stream backend; using it instead of mmap" << std::endl;
+        mapped_io = false;
     }
-}
 
-// Main function with modified output formatting
-int main() {
     // List of dataset files in the "dataset" folder
     std::vector<std::string> datasets = {
          
@@ -130,27 +143,51 @@ int main() {
        // "dataset/D12.txt"
     };
 
+    // The engines take the cipher as an object
+    const xec::KeySchedule builtin = xec::KeySchedule::from_cipher<Cipher>();
+
     // Tabular data for output
     std::cout << std::setw(15) << "Dataset" 
               << std::setw(25) << "Encryption Time (s)" 
 
               << std::setw(30) << "Avalanche Effect (%)" 
-              << std::setw(30) << "Throughput (Bytes/sec)" 
-              << "\n";
+              << std::setw(30) << (compress_level ? "Effective Throughput (B/s)" : "Throughput (Bytes/sec)");
+    if (compress_level) {
+        std::cout << std::setw(20) << "Compression Ratio";
+    }
+    std::cout << "\n";
 
     for (const auto &input_filename : datasets) {
-        const std::size_t chunk_size = 1048576; // 1MB chunk size
-        std::vector<std::string> binary_output;
-        double total_flipped_bits = 0.0;
-        size_t total_bits_processed = 0;
+        xec::CipherStats stats;
 
         try {
             // Get the plaintext size in bytes
-            std::streampos plaintext_size = getFileSize(input_filename);
+            std::streampos plaintext_size;
+            {
+                XEC_TIME_STAGE(xec::Stage::FileSize);
+                plaintext_size = getFileSize(input_filename);
+            }
+
+            // The 128-bit ciphertext goes next to the 256-bit output of ParaEn
+            std::string base_name = input_filename.substr(input_filename.find_last_of("/") + 1);
+            std::string stem = base_name.substr(0, base_name.find_last_of("."));
 
-            // Start encryption timer
+            // Start encryption timer (the container write is streamed alongside encryption)
             auto start_time = std::chrono::high_resolution_clock::now();
-            read_file_in_chunks(input_filename, chunk_size, binary_output, total_flipped_bits, total_bits_processed);
+            xec::IncrementalResult update;
+            if (incremental) {
+                update = xec::encrypt_incremental(builtin, input_filename, "output/encrypted128_" + stem + ".xec", chunk_size, nullptr, stats);
+            } else if (mapped_io) {
+                xec::discard_manifest("output/encrypted128_" + stem + ".xec");
+                xec::encrypt_file_mapped(builtin, input_filename, "output/encrypted128_" + stem + ".xec", chunk_size, nullptr, stats);
+            } else {
+                xec::discard_manifest("output/encrypted128_" + stem + ".xec");
+                // Encryption stays on this thread; the engine's writer thread streams finished chunks
+                // to the container while the next ones are encrypted
+                xec::encrypt_file_in_chunks(builtin, input_filename, "output/encrypted128_" + stem + ".xec",
+                                            text_export ? "output/encrypted128_" + stem + ".txt" : "", chunk_size, nullptr, in_flight, false,
+                                            nullptr, stats, compress_level);
+            }
             auto end_time = std::chrono::high_resolution_clock::now();
             
             // Calculate encryption times
@@ -159,7 +196,7 @@ int main() {
             double encryption_time_s = encryption_time_us / 1e6;    // Convert to seconds
 
             // Calculate Average Avalanche Effect
-            double avalanche_effect = (total_flipped_bits / total_bits_processed) * 100.0;
+            double avalanche_effect = stats.totals().avalanche_effect();
 
             // Calculate Average Encryption Throughput in Bytes per second
             double throughput = plaintext_size / encryption_time_s;
@@ -168,12 +205,23 @@ int main() {
             std::cout << std::setw(15) << input_filename
                       << std::setw(25) << std::fixed << std::setprecision(6) << encryption_time_s
                      << std::setw(30) << std::fixed << std::setprecision(4) << avalanche_effect
-                      << std::setw(30) << std::fixed << std::setprecision(2) << throughput
-                      << "\n";
+                      << std::setw(30) << std::fixed << std::setprecision(2) << throughput;
+            if (compress_level) {
+                // Plaintext bytes per stored payload byte
+                uint64_t payload_bytes = stats.totals().segments * Cipher::segment_bytes;
+                std::cout << std::setw(20) << std::fixed << std::setprecision(3)
+                          << (payload_bytes ? static_cast<double>(plaintext_size) / payload_bytes : 1.0);
+            }
+            std::cout << "\n";
+            if (incremental) {
+                std::cout << std::setw(15) << "" << " re-encrypted " << update.changed_chunks << "/" << update.chunks << " chunks ("
+                          << update.changed_bytes << " bytes" << (update.rebuilt ? ", new container" : "") << ")\n";
+            }
         } catch (const std::exception &e) {
             std::cerr << "Error processing " << input_filename << ": " << e.what() << std::endl;
         }
     }
 
+    xec::export_stage_timers(timers_json, timers_prom);
     return 0;
 }
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include "SegmentCipher.h"
+#include "WorkerPool.h"
+
+// In-memory encrypt/decrypt API for embedding the cipher in services (no file I/O).
+//
+// Messages are encrypted independently, each starting on a segment boundary. The cipher is
+// a positional XOR, so ciphertext is exactly as long as the plaintext: a partial last
+// segment uses the leading bytes of the mask, i.e. it equals the container's zero-padded
+// payload truncated to the plaintext length. encrypt and decrypt allow in == out.
+//
+// All calls work on caller-owned buffers and never allocate per message. The batch entry
+// points resolve the SIMD kernel once, run every message at full vector width, and split
+// large batches into groups of about BATCH_TASK_BYTES so small messages share a task.
+namespace xec {
+
+// Read-only and writable byte ranges over caller-owned memory (std::span is C++20)
+struct ConstBytes {
+    const uint8_t *data;
+    std::size_t size;
+};
+
+struct MutableBytes {
+    uint8_t *data;
+    std::size_t size;
+};
+
+// One independent message of a batch; `out` must have room for `size` bytes
+struct BatchMessage {
+    const uint8_t *in;
+    uint8_t *out;
+    std::size_t size;
+};
+
+// Bytes of messages handed to one pool task; smaller batches run on the calling thread
+constexpr std::size_t BATCH_TASK_BYTES = 256 * 1024;
+
+// Function to encrypt one message into `ciphertext`; returns the number of bytes written
+template <typename Cipher>
+std::size_t encrypt(ConstBytes plaintext, MutableBytes ciphertext) {
+    if (ciphertext.size < plaintext.size) {
+        throw std::invalid_argument("Ciphertext buffer is smaller than the plaintext");
+    }
+    Cipher::encrypt(plaintext.data, ciphertext.data, plaintext.size);
+    return plaintext.size;
+}
+
+// Function to decrypt one message into `plaintext`; returns the number of bytes written
+template <typename Cipher>
+std::size_t decrypt(ConstBytes ciphertext, MutableBytes plaintext) {
+    if (plaintext.size < ciphertext.size) {
+        throw std::invalid_argument("Plaintext buffer is smaller than the ciphertext");
+    }
+    Cipher::decrypt(ciphertext.data, plaintext.data, ciphertext.size);
+    return ciphertext.size;
+}
+
+namespace detail {
+
+inline void xor_messages(const SegmentMask &mask, XorMaskFn fn, const BatchMessage *messages, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        fn(mask, messages[i].in, messages[i].out, messages[i].size);
+    }
+}
+
+// Function to apply `mask` to every message, spreading groups of messages over `pool` and waiting
+// only for this batch's tasks, so concurrent batches can share one pool
+inline void xor_batch(const SegmentMask &mask, const BatchMessage *messages, std::size_t count, WorkerPool *pool) {
+    XorMaskFn fn = active_kernel().fn;
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        total += messages[i].size;
+    }
+    if (!pool || total <= BATCH_TASK_BYTES || pool->current_worker() != pool->size()) {
+        xor_messages(mask, fn, messages, count); // too small to split, or already on a worker
+        return;
+    }
+
+    std::mutex mtx;
+    std::condition_variable done;
+    std::size_t outstanding = 0;
+    std::size_t first = 0;
+    while (first < count) {
+        std::size_t last = first;
+        for (std::size_t bytes = 0; last < count && bytes < BATCH_TASK_BYTES; ++last) {
+            bytes += messages[last].size;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            ++outstanding;
+        }
+        pool->submit([&, first, last]() {
+            xor_messages(mask, fn, messages + first, last - first);
+            std::lock_guard<std::mutex> lock(mtx);
+            if (--outstanding == 0) {
+                done.notify_one();
+            }
+        });
+        first = last;
+    }
+    std::unique_lock<std::mutex> lock(mtx);
+    done.wait(lock, [&] { return outstanding == 0; });
+}
+
+} // namespace detail
+
+// Function to encrypt `count` independent messages in one call; `pool` may be null
+template <typename Cipher>
+void encrypt_batch(const BatchMessage *messages, std::size_t count, WorkerPool *pool = nullptr) {
+    detail::xor_batch(Cipher::mask, messages, count, pool);
+}
+
+// Function to decrypt `count` independent messages in one call; `pool` may be null
+template <typename Cipher>
+void decrypt_batch(const BatchMessage *messages, std::size_t count, WorkerPool *pool = nullptr) {
+    detail::xor_batch(Cipher::mask, messages, count, pool);
+}
+
+} // namespace xec